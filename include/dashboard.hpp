@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <stop_token>
+#include "nn.hpp"
+#include "train/spsc_queue.hpp"
+
+// Bins of the per-layer weight histograms
+#define DASHBOARD_BINS 32
+
+// Sample images kept on screen, newest replaces oldest
+#define DASHBOARD_SAMPLES 8
+
+// One update from the training loop, only the fields of its type are set
+struct dashboard_event
+{
+    enum class kind { sample, metrics, weights };
+
+    kind type = kind::metrics;
+    uint64_t step = 0;
+
+    // sample
+    vec<float> image;
+    size_t predicted = 0;
+    size_t actual = 0;
+
+    // metrics, accuracy < 0 when not measured
+    float loss = 0.0f;
+    float accuracy = -1.0f;
+
+    // weights
+    size_t layer = 0;
+    vec<float> histogram; // DASHBOARD_BINS counts over [lo, hi]
+    float lo = 0.0f;
+    float hi = 0.0f;
+};
+
+// Everything the renderer draws, owned by the render thread
+struct dashboard_state
+{
+    struct sample_t
+    {
+        vec<float> image;
+        size_t predicted;
+        size_t actual;
+    };
+
+    struct histogram_t
+    {
+        size_t layer;
+        vec<float> counts;
+        float lo;
+        float hi;
+    };
+
+    vec<sample_t> samples;
+    size_t next_sample = 0;
+    vec<std::pair<uint64_t, float>> loss;
+    vec<std::pair<uint64_t, float>> accuracy;
+    vec<histogram_t> histograms;
+
+    void apply(dashboard_event& event);
+};
+
+// Draws the dashboard state, called on the render thread only
+class dashboard_renderer
+{
+public:
+    virtual ~dashboard_renderer() = default;
+
+    // Draw one frame, returns false once the user closed the view
+    virtual bool draw(const dashboard_state& state) = 0;
+};
+
+// Renders nothing, for headless runs
+class null_renderer : public dashboard_renderer
+{
+    std::atomic<uint64_t> frames{0};
+
+public:
+    bool draw(const dashboard_state& state) override;
+
+    inline uint64_t get_frames() const
+        { return frames.load(); }
+};
+
+// SFML window with sample images, loss/accuracy curves and weight histograms
+std::unique_ptr<dashboard_renderer> make_sfml_renderer();
+
+// Live training view on its own thread. The training thread publishes into a
+// bounded lock-free ring and events that do not fit are dropped, so
+// publishing never blocks. Publish from one thread only.
+class dashboard
+{
+    spsc_queue<dashboard_event> events;
+    std::unique_ptr<dashboard_renderer> renderer;
+    std::atomic<uint64_t> dropped{0};
+    std::jthread worker;
+
+    void publish(dashboard_event&& event);
+    void run(std::stop_token stop);
+
+public:
+    dashboard(std::unique_ptr<dashboard_renderer> renderer, size_t capacity = 256);
+    ~dashboard();
+
+    void publish_sample(uint64_t step, const vec<float>& image, size_t predicted, size_t actual);
+    void publish_metrics(uint64_t step, float loss, float accuracy = -1.0f);
+
+    // Histogram the parameters of every layer past the first
+    void publish_weights(uint64_t step, const NeuralNetwork& nn);
+
+    inline uint64_t get_dropped() const
+        { return dropped.load(); }
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <sstream>
+#include "math/vec_utils.hpp"
+
+// Collects the pieces of a standalone inference header while layers export
+// themselves: namespace-scope constants and helpers, and the body of infer()
+class export_writer
+{
+    std::ostringstream decls;
+    std::ostringstream body;
+    std::set<std::string> helpers;
+    size_t next_id = 0;
+
+public:
+    // Emit an aligned constexpr array holding data, returns its name
+    std::string constant(const std::string& prefix, const float* data, size_t n);
+
+    // Declare a scratch buffer of n floats inside infer(), returns its name
+    std::string buffer(size_t n);
+
+    // Emit a namespace-scope helper the first time key is seen
+    void helper(const std::string& key, const std::string& code);
+
+    // Statements appended to infer(), indented by one level
+    inline std::ostream& code()
+        { return body; }
+
+    // Assemble the header, infer() reads `in` and copies `out` (of output_size floats) to its result
+    std::string str(const std::string& ns, size_t input_size, size_t output_size, const std::string& out) const;
+};
+
+// Exact float literal (hexadecimal), so exported weights round-trip bit for
+// bit. NaN and infinities become std::numeric_limits expressions, so the
+// including file needs <limits>.
+std::string float_literal(float f);
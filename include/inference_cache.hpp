@@ -0,0 +1,113 @@
+#pragma once
+
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "nn.hpp"
+
+// Vector width of the input hash, in 32-bit lanes
+#define HASH_LANES 8
+
+// Bookkeeping bytes charged per cached entry on top of its input and output
+#define INFERENCE_CACHE_ENTRY_OVERHEAD 96
+
+struct inference_cache_config_t
+{
+    size_t budget_bytes = 64 << 20; // inputs, outputs and bookkeeping of all shards
+    size_t shards = 16;             // each with its own lock and share of the budget
+};
+
+struct inference_cache_stats
+{
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stale = 0;     // misses on entries cached under older weights
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    double hit_seconds = 0.0;  // spent answering hits
+    double miss_seconds = 0.0; // spent running the network on misses
+
+    inline float hit_rate() const
+        { return hits + misses ? (float)hits / (hits + misses) : 0.0f; }
+
+    // Network time the hits would have cost, at the mean miss latency, minus
+    // what they did cost
+    inline double saved_seconds() const
+        { return misses ? hits * (miss_seconds / misses) - hit_seconds : 0.0; }
+};
+
+// Hash of the bit patterns of a float vector, HASH_LANES lanes at a time
+uint64_t hash_input(std::span<const float> in);
+
+// Outputs of a network for exact inputs seen before, in front of
+// NeuralNetwork::infer. Entries are spread over lock-striped shards by input
+// hash and evicted by CLOCK when a shard exceeds its budget. Each entry is
+// tagged with the network's weights version, so training, pruning or loading
+// parameters invalidates the whole cache without touching it; stale entries
+// are replaced as they are found.
+//
+// Lookups are safe from several threads. Misses run the network one at a time
+// (infer() shares one activation slab), and the network must not train while
+// the cache is used.
+class inference_cache
+{
+    struct entry
+    {
+        uint64_t hash = 0;
+        uint64_t version = 0;
+        vec<float> input;
+        vec<float> output;
+        bool referenced = false; // CLOCK bit, set on every hit
+        bool used = false;
+    };
+
+    struct alignas(64) shard_t
+    {
+        std::mutex mtx;
+        vec<entry> slots;
+        vec<size_t> free_slots;
+        std::unordered_multimap<uint64_t, size_t> index; // hash -> slot
+        size_t hand = 0;
+        size_t bytes = 0;
+
+        // counted under the shard lock, so busy threads share no counter
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t stale = 0;
+        size_t evictions = 0;
+        uint64_t hit_ns = 0;
+    };
+
+    NeuralNetwork& nn;
+    inference_cache_config_t cfg;
+    size_t shard_budget;
+    std::unique_ptr<shard_t[]> shards;
+    std::mutex infer_mtx;
+
+    std::atomic<uint64_t> miss_ns{0}; // misses run one at a time, this is never contended
+
+    inline shard_t& shard_of(uint64_t hash) const
+        { return shards[(hash >> 32) % cfg.shards]; }
+
+    // Slot of the entry for `in` in s, or SIZE_MAX; the shard lock must be held
+    size_t find(shard_t& s, uint64_t hash, std::span<const float> in) const;
+    bool lookup(uint64_t hash, std::span<const float> in, vec<float>& out);
+    void evict(shard_t& s, size_t slot);
+    void insert(uint64_t hash, uint64_t version, std::span<const float> in, std::span<const float> out);
+
+public:
+    inference_cache(NeuralNetwork& nn, const inference_cache_config_t& cfg = {});
+
+    // Cached output for `in` under the current weights, without running the network
+    bool lookup(std::span<const float> in, vec<float>& out);
+
+    // Output of the network for `in`, from the cache when possible
+    vec<float> infer(std::span<const float> in);
+
+    void clear();
+    inference_cache_stats get_stats() const;
+};
@@ -15,4 +15,13 @@ public:
 
     vec<float> forward(const vec<float>& in) override;
     vec<float> backprop(const vec<float>& grads, dataset_config_t config) override;
+
+    void forward_into(const float* in, size_t in_size, float* out) override;
+    void train_into(const float* in, size_t in_size, float* out) override;
+    void backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                       dataset_config_t config) override;
+    bool supports_inplace() const override
+        { return true; }
+    void account_memory(layer_memory& m) const override;
+    std::string export_cpp(export_writer& w, const std::string& in, size_t in_size) override;
 };
@@ -1,12 +1,62 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include <memory>
 #include <random>
 #include <cstdint>
+#include <span>
 
 #include "math/vec_utils.hpp"
 #include "math/dataset.hpp"
+#include "numa_memory.hpp"
+
+class export_writer;
+
+// Bytes a layer holds, by purpose. Each count is what the buffers use;
+// overhead is what their allocations hold beyond that (vector capacity
+// slack, mappings rounded up to whole pages).
+struct layer_memory
+{
+    std::string kind;
+    size_t parameters = 0;
+    size_t gradients = 0;
+    size_t activations = 0; // cached by forward() for backprop
+    size_t optimizer = 0;   // per-weight state of the update rule
+    size_t state = 0;       // get_buffers(): saved with the weights, not trained
+    size_t workspace = 0;   // scratch and inference-only copies
+    size_t overhead = 0;
+
+    inline size_t total() const
+        { return parameters + gradients + activations + optimizer + state + workspace + overhead; }
+
+    template <typename T>
+    void add(size_t& field, const vec<T>& v)
+    {
+        field += v.size() * sizeof(T);
+        overhead += (v.capacity() - v.size()) * sizeof(T);
+    }
+
+    template <typename T>
+    void add(size_t& field, const vec<vec<T>>& v)
+    {
+        overhead += v.capacity() * sizeof(vec<T>); // row headers
+        for (const vec<T>& row : v)
+            add(field, row);
+    }
+
+    inline void add(size_t& field, const numa_buffer& b)
+    {
+        field += b.size() * sizeof(float);
+        overhead += b.allocated_bytes() - b.size() * sizeof(float);
+    }
+
+    inline void add(size_t& field, const numa_matrix& m)
+    {
+        field += m.size() * m.cols() * sizeof(float);
+        overhead += m.allocated_bytes() - m.size() * m.cols() * sizeof(float);
+    }
+};
 
 class basic_layer
 {
@@ -25,6 +75,10 @@ public:
 
     inline size_t get_size()
         { return size; }
+
+    // Input width, 0 for a first layer that accepts whatever it is given
+    inline size_t get_prev_size() const
+        { return prev_size; }
     
     inline void set_gen(std::shared_ptr<std::mt19937> gen)
         { this->gen = gen; }
@@ -32,4 +86,90 @@ public:
     virtual void init(size_t prev_size);
     virtual vec<float> forward(const vec<float>& in) = 0;
     virtual vec<float> backprop(const vec<float>& grads, dataset_config_t config) = 0;
+
+    // Append a view of every trainable parameter buffer owned by this layer
+    virtual void get_params(vec<std::span<float>>& params);
+
+    // Append a view of every buffer that is part of the model but not trained
+    // by gradients (running statistics). Saved and loaded with the parameters.
+    virtual void get_buffers(vec<std::span<float>>& buffers);
+
+    // Read-only get_params() and get_buffers(), for code that only looks
+    inline vec<std::span<const float>> view_params() const
+    {
+        vec<std::span<float>> params;
+        const_cast<basic_layer *>(this)->get_params(params);
+        return { params.begin(), params.end() };
+    }
+    inline vec<std::span<const float>> view_buffers() const
+    {
+        vec<std::span<float>> buffers;
+        const_cast<basic_layer *>(this)->get_buffers(buffers);
+        return { buffers.begin(), buffers.end() };
+    }
+
+    // Called with false when no layer before this one has parameters, so its
+    // input gradients are never used
+    virtual void set_input_grads(bool needed);
+
+    // Whether backprop trains anything in this layer
+    virtual bool has_params() const
+        { return false; }
+
+    // Bracket a run of training steps, with no other thread in the layer:
+    // begin_updates() before the first forward(), end_updates() after the
+    // last backprop() and before anything else reads the weights
+    virtual void begin_updates();
+    virtual void end_updates();
+
+    // Inference-only forward into a caller-provided buffer of get_size() floats.
+    // Leaves the caches used by backprop alone. out may alias in when
+    // supports_inplace() is true.
+    virtual void forward_into(const float* in, size_t in_size, float* out);
+    virtual bool supports_inplace() const
+        { return false; }
+
+    // forward_into() on n inputs stored one after another, each in_size
+    // floats, writing n outputs of out_size floats. The default runs them one
+    // by one; layers override it to read their weights once per batch.
+    virtual void forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size);
+
+    // Training on caller-owned buffers, which NeuralNetwork::backprop() plans
+    // in one slab per thread. train_into() is forward() writing to out.
+    // backprop_into() gets the same in and out back with grad_out = d loss /
+    // d out, which it may overwrite, updates the parameters and writes
+    // d loss / d in to grad_in unless that is null. grad_in may alias
+    // grad_out when supports_inplace() is true. The defaults go through
+    // forward() and backprop(), and keep their per-layer caches.
+    virtual void train_into(const float* in, size_t in_size, float* out);
+    virtual void backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                               dataset_config_t config);
+
+    // Zero the smallest-magnitude weights so that `sparsity` of them are zero
+    // and keep them zero through training. structured prunes whole blocks of
+    // the sparse inference format instead of single weights.
+    virtual void prune(float sparsity, bool structured);
+
+    // Switch inference (forward_into) to a sparse copy of the weights
+    virtual void compress();
+
+    // Give forward_into a copy of the weights on every NUMA node, read by
+    // threads running there. Dropped once the weights change.
+    virtual void replicate();
+
+    // Interchangeable kernel variants for the autotuner, identified by a key
+    // describing the layer's shape. Layers with one variant are not tuned.
+    virtual std::string tuning_key() const;
+    virtual size_t num_variants() const
+        { return 1; }
+    virtual size_t get_variant() const
+        { return 0; }
+    virtual void set_variant(size_t variant);
+
+    // Add the bytes of every buffer this layer owns to m and name its kind
+    virtual void account_memory(layer_memory& m) const;
+
+    // Emit standalone C++ for this layer's forward pass reading the buffer
+    // named `in`, returns the name of the buffer holding the output
+    virtual std::string export_cpp(export_writer& w, const std::string& in, size_t in_size);
 };
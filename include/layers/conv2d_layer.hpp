@@ -0,0 +1,64 @@
+#pragma once
+
+#include "layers/basic_layer.hpp"
+#include "math/dataset.hpp"
+#include "numa_memory.hpp"
+
+// Kernels up to this size use direct convolution, larger ones im2col + GEMM,
+// unless the autotuner picked another variant
+#define CONV2D_DIRECT_MAX_KERNEL 3
+
+// 2D convolution over a flattened (channels, height, width) input.
+// Output is flattened as (out_channels, out_height, out_width).
+class conv2d_layer : public basic_layer
+{
+    size_t in_c, in_h, in_w;
+    size_t out_c, out_h, out_w;
+    size_t kernel, stride, padding;
+
+    numa_buffer weights; // out_c x (in_c * kernel * kernel)
+    vec<float> biases;  // out_c
+
+    numa_buffer cols; // im2col buffer of the last input, (in_c * k * k) x (out_h * out_w)
+
+    // 0 is direct convolution, v > 0 is im2col + GEMM with tile CONV2D_TILES[v - 1]
+    size_t variant;
+
+    inline bool use_direct() const
+        { return variant == 0; }
+
+    void im2col(const vec<float>& in);
+    void col2im(const vec<float>& dcols, vec<float>& out) const;
+
+    vec<float> forward_direct(const vec<float>& in);
+    vec<float> forward_gemm(const vec<float>& in);
+    vec<float> backprop_direct(const vec<float>& grads, vec<float>& wgrads, vec<float>& bgrads);
+    vec<float> backprop_gemm(const vec<float>& grads, vec<float>& wgrads, vec<float>& bgrads);
+
+public:
+    conv2d_layer(size_t in_channels, size_t in_height, size_t in_width,
+                 size_t out_channels, size_t kernel, size_t stride = 1, size_t padding = 0);
+    ~conv2d_layer();
+
+    void init(size_t prev_size) override;
+    void get_params(vec<std::span<float>>& params) override;
+    bool has_params() const override
+        { return true; }
+    void account_memory(layer_memory& m) const override;
+
+    std::string tuning_key() const override;
+    size_t num_variants() const override;
+    inline size_t get_variant() const override
+        { return variant; }
+    void set_variant(size_t v) override;
+
+    vec<float> forward(const vec<float>& in);
+    vec<float> backprop(const vec<float>& grads, dataset_config_t config);
+
+    inline size_t get_out_channels() const
+        { return out_c; }
+    inline size_t get_out_height() const
+        { return out_h; }
+    inline size_t get_out_width() const
+        { return out_w; }
+};
@@ -15,7 +15,27 @@ public:
     ~dense_layer();
 
     void init(size_t prev_size) override;
+    void get_params(vec<std::span<float>>& params) override;
+    void prune(float sparsity, bool structured) override;
+    void compress() override;
+    void replicate() override;
+    void set_input_grads(bool needed) override;
+    bool has_params() const override;
+    void begin_updates() override;
+    void end_updates() override;
+    void account_memory(layer_memory& m) const override;
+
+    std::string tuning_key() const override;
+    size_t num_variants() const override;
+    size_t get_variant() const override;
+    void set_variant(size_t v) override;
 
     vec<float> forward(const vec<float>& in);
     vec<float> backprop(const vec<float>& grad, dataset_config_t config);
+    void forward_into(const float* in, size_t in_size, float* out) override;
+    void forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size) override;
+    void train_into(const float* in, size_t in_size, float* out) override;
+    void backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                       dataset_config_t config) override;
+    std::string export_cpp(export_writer& w, const std::string& in, size_t in_size) override;
 };
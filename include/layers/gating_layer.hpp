@@ -13,6 +13,15 @@ public:
     ~gating_layer();
 
     void init(size_t prev_size) override;
+    void get_params(vec<std::span<float>>& params) override;
+    bool has_params() const override
+        { return true; }
     vec<float> forward(const vec<float>& in);
     vec<float> backprop(const vec<float>& grads, dataset_config_t config);
+
+    void forward_into(const float* in, size_t in_size, float* out) override;
+    bool supports_inplace() const override
+        { return true; }
+    void account_memory(layer_memory& m) const override;
+    std::string export_cpp(export_writer& w, const std::string& in, size_t in_size) override;
 };
@@ -2,15 +2,57 @@
 
 #include "layers/basic_layer.hpp"
 #include "math/dataset.hpp"
+#include "math/sparse.hpp"
+#include "numa_memory.hpp"
+
+// Inputs with at most this fraction of entries that differ from a shared base
+// value take the sparse path, unless the autotuner picked another threshold.
+// The base is zero behind a ReLU, or the value every background pixel of an
+// image has after normalization.
+#define LINEAR_SPARSE_MAX_DENSITY 0.6f
+
+// Inputs too dense for the sparse path make the next samples skip the scan,
+// twice as many after every miss in a row, up to this many
+#define LINEAR_SPARSE_RECHECK 64
 
 class linear_layer : public basic_layer
 {
-    vec2<float> weights;
+    // one contiguous block each, placed by the memory_config_t in effect at init
+    numa_matrix weights;
     vec<float> biases;
 
-    // gradients accumulated by backprop
-    vec2<float> weight_grads;
+    // gradients of the last backprop; the weight gradient is their outer
+    // product with last_input, built by get_weight_grads()
     vec<float> bias_grads;
+    bool need_input_grads = true;
+
+    // index into the autotuner's sparse-path density thresholds
+    size_t variant;
+
+    // Between begin_updates() and end_updates() the weights in effect are
+    // weights[o][j] + row_offsets[o]: the sparse path applies the part of an
+    // update shared by a whole row there instead of to every weight.
+    // row_sums[o] tracks the sum of weights[o] for inputs centred on a base.
+    vec<float> row_offsets;
+    vec<float> row_sums;
+    bool centred = false; // row_sums are valid, inputs may have a nonzero base
+
+    // what forward() found in one sample's input, kept per thread
+    struct sparse_input;
+    sparse_input& thread_input() const;
+    void backprop_sparse(const float* grads, float* grad_in, dataset_config_t config, const sparse_input& in);
+
+    // pruned weights have mask 0 and stay zero through training, empty if unpruned
+    vec2<uint8_t> mask;
+
+    // sparse weights used by forward_into after compress(), dropped by
+    // end_updates() and prune()
+    std::unique_ptr<bcsr_matrix> compressed;
+    vec<float> padded_input; // one row per sample of the largest batch so far
+
+    // per-node weight copies used by forward_into after replicate(), dropped
+    // like compressed
+    vec<numa_matrix> replicas;
 
 public:
     linear_layer(size_t size);
@@ -18,10 +60,35 @@ public:
 
     vec<float> forward(const vec<float>& in);
     vec<float> backprop(const vec<float>& grads, dataset_config_t config);
+    void forward_into(const float* in, size_t in_size, float* out) override;
+    void forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size) override;
+    void train_into(const float* in, size_t in_size, float* out) override;
+    void backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                       dataset_config_t config) override;
+    std::string export_cpp(export_writer& w, const std::string& in, size_t in_size) override;
 
     void init(size_t prev_size);
+    void get_params(vec<std::span<float>>& params) override;
+    void set_input_grads(bool needed) override
+        { need_input_grads = needed; }
+    std::string tuning_key() const override;
+    size_t num_variants() const override;
+    inline size_t get_variant() const override
+        { return variant; }
+    void set_variant(size_t v) override;
+
+    void prune(float sparsity, bool structured) override;
+    void compress() override;
+    void replicate() override;
+    void account_memory(layer_memory& m) const override;
+
+    void begin_updates() override;
+    void end_updates() override;
+    bool has_params() const override
+        { return prev_size != 0; }
 
-    // accessors for parameter gradients (const refs)
-    const vec2<float>& get_weight_grads() const { return weight_grads; }
+    // parameter gradients of the last backprop(); the weight gradient needs
+    // last_input, which training from a planned slab does not keep
+    numa_matrix get_weight_grads() const;
     const vec<float>& get_bias_grads() const { return bias_grads; }
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "layers/basic_layer.hpp"
+#include "math/dataset.hpp"
+
+// Max pooling over a flattened (channels, height, width) input
+class maxpool_layer : public basic_layer
+{
+    size_t channels, in_h, in_w;
+    size_t out_h, out_w;
+    size_t pool, stride;
+
+    vec<size_t> argmax_idx; // input index that won each output, for backprop
+
+public:
+    maxpool_layer(size_t channels, size_t in_height, size_t in_width, size_t pool, size_t stride = 0);
+    ~maxpool_layer();
+
+    void init(size_t prev_size) override;
+    void account_memory(layer_memory& m) const override;
+
+    vec<float> forward(const vec<float>& in);
+    vec<float> backprop(const vec<float>& grads, dataset_config_t config);
+
+    inline size_t get_out_height() const
+        { return out_h; }
+    inline size_t get_out_width() const
+        { return out_w; }
+};
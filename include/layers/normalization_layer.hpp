@@ -6,15 +6,54 @@
 #include "layers/linear_layer.hpp"
 #include "math/vec_utils.hpp"
 
+// Normalizes its input, then applies a linear layer.
+//
+// "layer" mode standardizes every sample over its own features (layer norm).
+// "batch" mode standardizes every feature over the samples (batch norm). The
+// network trains one sample at a time, so the batch statistics are running
+// averages over the sample stream; forward() updates them and the inference
+// paths (forward_into, export) use them frozen.
 class normalization_layer : public basic_layer
 {
     std::unique_ptr<linear_layer> linear;
+    bool batch;
+    float momentum;
+    bool need_input_grads = true;
+
+    // cached by forward() for backprop
+    vec<float> last_norm;
+    float last_inv_std = 0.0f;     // layer mode
+    vec<float> batch_inv_std;      // batch mode, per feature
+
+    // batch mode running statistics, returned by get_buffers() so they are
+    // snapshotted and checkpointed but never treated as weights
+    vec<float> running_mean;
+    vec<float> running_var;
+
+    vec<float> scratch; // normalized input for forward_into
+
+    void normalize(const float* in, size_t n, float* norm) const;
+
 public:
-    normalization_layer(size_t size);
+    // mode is "layer" or "batch"; momentum is the weight of each new sample
+    // in the batch mode running statistics
+    normalization_layer(size_t size, const std::string& mode = "layer", float momentum = 0.01f);
     ~normalization_layer();
 
     void init(size_t prev_size) override;
+    void get_params(vec<std::span<float>>& params) override;
+    void get_buffers(vec<std::span<float>>& buffers) override;
+    void set_input_grads(bool needed) override;
+    bool has_params() const override;
+    void begin_updates() override;
+    void end_updates() override;
+    void prune(float sparsity, bool structured) override;
+    void compress() override;
+    void replicate() override;
+    void account_memory(layer_memory& m) const override;
 
     vec<float> forward(const vec<float>& in);
     vec<float> backprop(const vec<float>& grads, dataset_config_t config);
+    void forward_into(const float* in, size_t in_size, float* out) override;
+    std::string export_cpp(export_writer& w, const std::string& in, size_t in_size) override;
 };
@@ -6,6 +6,7 @@
 #include <memory>
 #include <iostream>
 #include "math/vec_utils.hpp"
+#include "export.hpp"
 
 // Base class for activations (allows virtual dispatch for proper derivatives)
 class Activation
@@ -14,6 +15,19 @@ public:
     virtual ~Activation() = default;
     virtual vec<float> forward(const vec<float>& x) = 0;
     virtual vec<float> backward(const vec<float>& grad) = 0;
+
+    // What forward() keeps for backward()
+    virtual const vec<float>& cached() const = 0;
+
+    // Stateless forward for inference, out may alias x
+    virtual void apply(const float* x, float* out, size_t n) const = 0;
+
+    // Stateless backward from the output y of apply(), for planned training.
+    // grad_in may alias grad_out.
+    virtual void apply_backward(const float* y, const float* grad_out, float* grad_in, size_t n) const = 0;
+
+    // Emit the code of apply() for the exported header
+    virtual void export_cpp(export_writer& w, const std::string& x, const std::string& out, size_t n) const = 0;
     
     // Factory method
     static std::unique_ptr<Activation> create(const std::string& name);
@@ -24,6 +38,9 @@ class ReLU : public Activation
 {
     vec<float> last_input;
 public:
+    const vec<float>& cached() const override
+        { return last_input; }
+
     vec<float> forward(const vec<float>& x) override
     {
         last_input = x;
@@ -41,6 +58,24 @@ public:
             out[i] = last_input[i] > 0 ? grad[i] : 0;
         return out;
     }
+
+    void apply(const float* x, float* out, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = x[i] > 0 ? x[i] : 0;
+    }
+
+    void apply_backward(const float* y, const float* grad_out, float* grad_in, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            grad_in[i] = y[i] > 0 ? grad_out[i] : 0;
+    }
+
+    void export_cpp(export_writer& w, const std::string& x, const std::string& out, size_t n) const override
+    {
+        w.code() << "    for (size_t i = 0; i < " << n << "; ++i)\n"
+                 << "        " << out << "[i] = " << x << "[i] > 0 ? " << x << "[i] : 0;\n";
+    }
 };
 
 // Softmax activation
@@ -48,6 +83,9 @@ class Softmax : public Activation
 {
     vec<float> last_output;  // store softmax output for backward pass
 public:
+    const vec<float>& cached() const override
+        { return last_output; }
+
     vec<float> forward(const vec<float>& x) override
     {
         // Subtract max for numerical stability
@@ -77,6 +115,44 @@ public:
         }
         return out;
     }
+
+    void apply(const float* x, float* out, size_t n) const override
+    {
+        const float max_x = *std::max_element(x, x + n);
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = std::exp(x[i] - max_x);
+            sum += out[i];
+        }
+        for (size_t i = 0; i < n; ++i)
+            out[i] /= sum;
+    }
+
+    // Same Jacobian-vector product as backward(): s_i * (grad_i - sum_j s_j * grad_j)
+    void apply_backward(const float* y, const float* grad_out, float* grad_in, size_t n) const override
+    {
+        float dot = 0.0f;
+        for (size_t j = 0; j < n; ++j)
+            dot += y[j] * grad_out[j];
+        for (size_t i = 0; i < n; ++i)
+            grad_in[i] = y[i] * (grad_out[i] - dot);
+    }
+
+    void export_cpp(export_writer& w, const std::string& x, const std::string& out, size_t n) const override
+    {
+        w.code() << "    {\n"
+                 << "        const float max_x = *std::max_element(" << x << ", " << x << " + " << n << ");\n"
+                 << "        float sum = 0.0f;\n"
+                 << "        for (size_t i = 0; i < " << n << "; ++i)\n"
+                 << "        {\n"
+                 << "            " << out << "[i] = std::exp(" << x << "[i] - max_x);\n"
+                 << "            sum += " << out << "[i];\n"
+                 << "        }\n"
+                 << "        for (size_t i = 0; i < " << n << "; ++i)\n"
+                 << "            " << out << "[i] /= sum;\n"
+                 << "    }\n";
+    }
 };
 
 // Sigmoid activation
@@ -84,6 +160,9 @@ class Sigmoid : public Activation
 {
     vec<float> last_output;
 public:
+    const vec<float>& cached() const override
+        { return last_output; }
+
     vec<float> forward(const vec<float>& x) override
     {
         vec<float> out(x.size());
@@ -100,6 +179,24 @@ public:
             out[i] = last_output[i] * (1.0f - last_output[i]) * grad[i];
         return out;
     }
+
+    void apply(const float* x, float* out, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = 1.0f / (1.0f + std::exp(-x[i]));
+    }
+
+    void apply_backward(const float* y, const float* grad_out, float* grad_in, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            grad_in[i] = y[i] * (1.0f - y[i]) * grad_out[i];
+    }
+
+    void export_cpp(export_writer& w, const std::string& x, const std::string& out, size_t n) const override
+    {
+        w.code() << "    for (size_t i = 0; i < " << n << "; ++i)\n"
+                 << "        " << out << "[i] = 1.0f / (1.0f + std::exp(-" << x << "[i]));\n";
+    }
 };
 
 // Tanh activation
@@ -107,6 +204,9 @@ class Tanh : public Activation
 {
     vec<float> last_output;
 public:
+    const vec<float>& cached() const override
+        { return last_output; }
+
     vec<float> forward(const vec<float>& x) override
     {
         vec<float> out(x.size());
@@ -123,6 +223,24 @@ public:
             out[i] = (1.0f - last_output[i] * last_output[i]) * grad[i];
         return out;
     }
+
+    void apply(const float* x, float* out, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = std::tanh(x[i]);
+    }
+
+    void apply_backward(const float* y, const float* grad_out, float* grad_in, size_t n) const override
+    {
+        for (size_t i = 0; i < n; ++i)
+            grad_in[i] = (1.0f - y[i] * y[i]) * grad_out[i];
+    }
+
+    void export_cpp(export_writer& w, const std::string& x, const std::string& out, size_t n) const override
+    {
+        w.code() << "    for (size_t i = 0; i < " << n << "; ++i)\n"
+                 << "        " << out << "[i] = std::tanh(" << x << "[i]);\n";
+    }
 };
 
 // Implementation of factory method
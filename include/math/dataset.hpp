@@ -7,6 +7,9 @@
 #include <cmath>
 #include "math/vec_utils.hpp"
 
+// Classes of the MNIST-style datasets, labels are one-hot over these
+#define NUM_CLASSES 10
+
 using data_pair = std::pair<vec<float>, vec<float>>;
 
 struct dataset_config_t
@@ -22,6 +25,33 @@ struct dataset_t
     dataset_config_t config;
 };
 
+// Bytes held by a dataset's samples; overhead is vector capacity slack and
+// the per-sample vector headers
+struct dataset_memory
+{
+    size_t inputs = 0;
+    size_t labels = 0;
+    size_t overhead = 0;
+
+    inline size_t total() const
+        { return inputs + labels + overhead; }
+};
+
+inline dataset_memory memory_usage(const dataset_t& dataset)
+{
+    dataset_memory m;
+    m.overhead = dataset.data.capacity() * sizeof(data_pair);
+    for (const data_pair& sample : dataset.data)
+    {
+        m.inputs += sample.first.size() * sizeof(float);
+        m.labels += sample.second.size() * sizeof(float);
+        m.overhead += (sample.first.capacity() - sample.first.size() +
+                       sample.second.capacity() - sample.second.size()) * sizeof(float);
+    }
+
+    return m;
+}
+
 inline dataset_t create_dataset(const vec2<float>& X, const vec2<float>& y)
 {
     dataset_t dataset;
@@ -33,7 +63,41 @@ inline dataset_t create_dataset(const vec2<float>& X, const vec2<float>& y)
     return dataset;
 }
 
-inline dataset_t load_csv_dataset(const std::string& filename, bool has_header = false, char delimiter = ',')
+// Parse one MNIST-style CSV row (label, pixels...) into a normalized sample
+// with a one-hot label. Returns false for empty rows.
+inline bool parse_csv_sample(const std::string& line, char delimiter, data_pair& sample)
+{
+    std::stringstream ss(line);
+    std::string cell;
+    vec<float> row;
+
+    while (std::getline(ss, cell, delimiter))
+        row.push_back(std::stof(cell));
+
+    if (row.empty())
+        return false;
+
+    // --- MNIST: label, 784 = pixels ---
+    float label_val = row.front();
+    row.erase(row.begin());
+
+    // one-hot encode label, skipping rows whose label is not a class index
+    if (!(label_val >= 0 && label_val < NUM_CLASSES))
+        return false;
+    vec<float> label(NUM_CLASSES, 0.0f);
+    label[(int)label_val] = 1.0f;
+
+    for (auto& n : row)
+        n /= 255;
+
+    sample = { std::move(row), std::move(label) };
+    return true;
+}
+
+// Load a CSV dataset. With num_shards > 1 only every num_shards-th row starting
+// at row `shard` is parsed, so each data-parallel rank holds just its own part.
+inline dataset_t load_csv_dataset(const std::string& filename, bool has_header = false, char delimiter = ',',
+                                  size_t shard = 0, size_t num_shards = 1)
 {
     std::ifstream file(filename);
     if (!file.is_open())
@@ -44,6 +108,7 @@ inline dataset_t load_csv_dataset(const std::string& filename, bool has_header =
     vec<vec<float>> y;
 
     bool first_line = true;
+    size_t row_idx = 0;
     while (std::getline(file, line))
     {
         if (first_line && has_header)
@@ -52,29 +117,15 @@ inline dataset_t load_csv_dataset(const std::string& filename, bool has_header =
             continue;
         }
 
-        std::stringstream ss(line);
-        std::string cell;
-        vec<float> row;
-
-        while (std::getline(ss, cell, delimiter))
-            row.push_back(std::stof(cell));
-
-        if (row.empty())
+        if (row_idx++ % num_shards != shard)
             continue;
 
-        // --- MNIST: label, 784 = pixels ---
-        float label_val = row.front();
-        row.erase(row.begin());
-
-        // one-hot encode label
-        vec<float> label(10, 0.0f);
-        label[(int)label_val] = 1.0f;
-
-        for (auto& n : row)
-            n /= 255;
+        data_pair sample;
+        if (!parse_csv_sample(line, delimiter, sample))
+            continue;
 
-        X.push_back(row);
-        y.push_back(label);
+        X.push_back(std::move(sample.first));
+        y.push_back(std::move(sample.second));
     }
 
     file.close();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <thread>
+#include <condition_variable>
+#include "math/dataset.hpp"
+
+// Sequential reader of samples from disk
+class sample_source
+{
+public:
+    virtual ~sample_source() = default;
+
+    // Read the next sample, false at end of file. Samples whose label is not
+    // one of the NUM_CLASSES classes are skipped.
+    virtual bool read(data_pair& sample) = 0;
+
+    // Go back to the first sample
+    virtual void rewind() = 0;
+};
+
+// MNIST-style CSV rows: label, pixels...
+class csv_source : public sample_source
+{
+    std::ifstream file;
+    std::string filename;
+    bool has_header;
+    char delimiter;
+
+public:
+    csv_source(const std::string& filename, bool has_header = false, char delimiter = ',');
+
+    bool read(data_pair& sample) override;
+    void rewind() override;
+};
+
+// IDX image and label files as distributed with MNIST / Fashion-MNIST
+class idx_source : public sample_source
+{
+    std::ifstream images;
+    std::ifstream labels;
+    std::string images_path;
+    std::string labels_path;
+    size_t count = 0;
+    size_t pixels = 0;
+    size_t read_count = 0;
+    vec<uint8_t> raw;
+
+    void open();
+
+public:
+    idx_source(const std::string& images_path, const std::string& labels_path);
+
+    bool read(data_pair& sample) override;
+    void rewind() override;
+};
+
+struct stream_config_t
+{
+    size_t chunk_size = 1024;     // samples handed to the training loop at once
+    size_t read_ahead = 4;        // chunks buffered ahead of the consumer
+    size_t shuffle_window = 8192; // samples shuffled together, 0 keeps file order
+    uint32_t seed = 0;
+};
+
+// Feeds a dataset from disk in fixed-size chunks with a background reader, so
+// memory stays bounded by (read_ahead + 1) * chunk_size + shuffle_window
+// samples no matter how large the file is.
+//
+// Shuffling uses a window: each sample read replaces a random one from the
+// window, which is emitted. Samples further apart than the window in the
+// file are never swapped with each other.
+class dataset_stream
+{
+    std::unique_ptr<sample_source> source;
+    stream_config_t cfg;
+    dataset_config_t train_cfg;
+    std::mt19937 gen;
+
+    std::deque<dataset_t> ready;
+    bool finished = false;
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable_any not_full;
+    std::jthread reader;
+
+    void produce(std::stop_token stop);
+
+public:
+    dataset_stream(std::unique_ptr<sample_source> source, dataset_config_t train_cfg, stream_config_t cfg = {});
+    ~dataset_stream();
+
+    // Start a new pass over the file
+    void rewind();
+
+    // Next chunk of the current pass, false once the pass is exhausted
+    bool next(dataset_t& chunk);
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <map>
+#include "math/dataset.hpp"
+
+// Non-owning window over a dataset_t: a shared order of sample indices and a
+// range of it, optionally with one hole cut out (the held-out fold of a k-fold
+// split). Copies are cheap and never touch the samples; the backing dataset
+// must outlive every view made from it.
+class dataset_view
+{
+    const dataset_t* source = nullptr;
+    std::shared_ptr<const vec<size_t>> order; // indices into source->data, null for identity
+    size_t first = 0;
+    size_t hole = 0;       // view position where the hole starts
+    size_t hole_size = 0;
+
+public:
+    size_t size = 0;
+    dataset_config_t config{};
+
+    dataset_view() = default;
+
+    // The whole dataset, in order
+    dataset_view(const dataset_t& dataset)
+        : source(&dataset), size(dataset.size), config(dataset.config) {}
+
+    dataset_view(const dataset_t& dataset, std::shared_ptr<const vec<size_t>> order_, size_t first_, size_t size_,
+                 dataset_config_t config_, size_t hole_ = 0, size_t hole_size_ = 0)
+        : source(&dataset), order(std::move(order_)), first(first_), hole(hole_), hole_size(hole_size_),
+          size(size_), config(config_) {}
+
+    // Index into the backing dataset of the i-th sample of the view
+    inline size_t index(size_t i) const
+    {
+        const size_t pos = first + (i < hole ? i : i + hole_size);
+        return order ? (*order)[pos] : pos;
+    }
+
+    inline const data_pair& operator[](size_t i) const
+        { return source->data[index(i)]; }
+
+    inline const dataset_t& backing() const
+        { return *source; }
+
+    // Backing indices of every sample, in view order
+    vec<size_t> indices() const
+    {
+        vec<size_t> idx(size);
+        for (size_t i = 0; i < size; ++i)
+            idx[i] = index(i);
+
+        return idx;
+    }
+};
+
+// Class of a sample, taken from its one-hot label
+inline size_t label_class(const data_pair& sample)
+{
+    const vec<float>& y = sample.second;
+    return std::distance(y.begin(), std::max_element(y.begin(), y.end()));
+}
+
+// Shuffle a view and cut it in two: the first holds round(fraction * size) samples
+inline std::pair<dataset_view, dataset_view> random_split(const dataset_view& view, float fraction, std::mt19937& gen)
+{
+    auto order = std::make_shared<vec<size_t>>(view.indices());
+    std::shuffle(order->begin(), order->end(), gen);
+
+    const size_t n = std::min(view.size, (size_t)std::lround(fraction * view.size));
+    return { dataset_view(view.backing(), order, 0, n, view.config),
+             dataset_view(view.backing(), order, n, view.size - n, view.config) };
+}
+
+// Like random_split, but every class is cut at the same fraction so both
+// halves keep the label distribution of the view
+inline std::pair<dataset_view, dataset_view> stratified_split(const dataset_view& view, float fraction, std::mt19937& gen)
+{
+    std::map<size_t, vec<size_t>> classes;
+    for (size_t i = 0; i < view.size; ++i)
+        classes[label_class(view[i])].push_back(view.index(i));
+
+    vec<size_t> head, tail;
+    for (auto& [label, members] : classes)
+    {
+        std::shuffle(members.begin(), members.end(), gen);
+        const size_t n = std::min(members.size(), (size_t)std::lround(fraction * members.size()));
+        head.insert(head.end(), members.begin(), members.begin() + n);
+        tail.insert(tail.end(), members.begin() + n, members.end());
+    }
+
+    // Interleave the classes again, SGD does not like long runs of one label
+    std::shuffle(head.begin(), head.end(), gen);
+    std::shuffle(tail.begin(), tail.end(), gen);
+
+    const size_t n = head.size();
+    head.insert(head.end(), tail.begin(), tail.end());
+    auto order = std::make_shared<const vec<size_t>>(std::move(head));
+
+    return { dataset_view(view.backing(), order, 0, n, view.config),
+             dataset_view(view.backing(), order, n, view.size - n, view.config) };
+}
+
+// K-fold cross-validation over a view. All folds share one shuffled order:
+// fold f is a contiguous range of it and its training set is the same order
+// with that range cut out, so iterating the folds copies no samples.
+class k_fold
+{
+    const dataset_t* source;
+    std::shared_ptr<const vec<size_t>> order;
+    vec<size_t> bounds; // fold f is [bounds[f], bounds[f + 1])
+    dataset_config_t config;
+
+public:
+    k_fold(const dataset_view& view, size_t k, std::mt19937& gen, bool stratified = false)
+        : source(&view.backing()), config(view.config)
+    {
+        if (k < 2 || k > view.size)
+            throw std::invalid_argument("k-fold needs 2 <= k <= " + std::to_string(view.size) + ", got " + std::to_string(k));
+
+        vec<size_t> idx = view.indices();
+        std::shuffle(idx.begin(), idx.end(), gen);
+
+        bounds.resize(k + 1);
+        if (!stratified)
+        {
+            for (size_t f = 0; f <= k; ++f)
+                bounds[f] = f * idx.size() / k;
+        }
+        else
+        {
+            // Deal each class round-robin over the folds
+            std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b)
+                { return label_class(source->data[a]) < label_class(source->data[b]); });
+
+            vec<vec<size_t>> folds(k);
+            for (size_t i = 0; i < idx.size(); ++i)
+                folds[i % k].push_back(idx[i]);
+
+            idx.clear();
+            for (size_t f = 0; f < k; ++f)
+            {
+                bounds[f] = idx.size();
+                std::shuffle(folds[f].begin(), folds[f].end(), gen);
+                idx.insert(idx.end(), folds[f].begin(), folds[f].end());
+            }
+            bounds[k] = idx.size();
+        }
+
+        order = std::make_shared<const vec<size_t>>(std::move(idx));
+    }
+
+    inline size_t size() const
+        { return bounds.size() - 1; }
+
+    // {training, validation} views of fold f
+    std::pair<dataset_view, dataset_view> operator[](size_t f) const
+    {
+        const size_t start = bounds[f], count = bounds[f + 1] - bounds[f];
+        return { dataset_view(*source, order, 0, order->size() - count, config, start, count),
+                 dataset_view(*source, order, start, count, config) };
+    }
+};
@@ -2,108 +2,219 @@
 
 #include <cmath>
 #include <string>
-#include <functional>
+#include <algorithm>
 #include "math/vec_utils.hpp"
 
-// Loss function type: takes predicted and target vectors, returns scalar loss
-using loss_fn = std::function<float(const vec<float>&, const vec<float>&)>;
+// Vector width of the loss kernels
+#define LOSS_LANES 8
 
-// Loss gradient type: takes target and predicted vectors, returns gradient w.r.t. predictions
-using loss_grad_fn = std::function<vec<float>(const vec<float>&, const vec<float>&)>;
+// Predictions are clamped to [LOSS_EPS, 1 - LOSS_EPS] before taking logs
+#define LOSS_EPS 1e-7f
 
-// Struct to hold both loss and its gradient
-struct loss_pair {
-    loss_fn loss;
-    loss_grad_fn grad;
+typedef float loss_vec __attribute__((vector_size(LOSS_LANES * sizeof(float))));
+
+// How the per-sample losses of a batch are combined
+enum class loss_reduction
+{
+    mean,
+    sum,
+    none // also write every sample's loss to per_sample
 };
 
-// Mean Squared Error loss
-inline float mse_loss(const vec<float>& pred, const vec<float>& target)
+// Helpers take vectors by reference, passing them by value changes the ABI
+// depending on whether AVX is enabled
+inline void loss_load(loss_vec& v, const float* p)
 {
-    float loss = 0.0f;
-    for (size_t i = 0; i < pred.size(); ++i)
-    {
-        const float diff = pred[i] - target[i];
-        loss += diff * diff;
-    }
-    return loss / pred.size();
+    __builtin_memcpy(&v, p, sizeof(v));
+}
+
+inline void loss_store(float* p, const loss_vec& v)
+{
+    __builtin_memcpy(p, &v, sizeof(v));
+}
+
+inline float loss_hsum(const loss_vec& v)
+{
+    float sum = 0.0f;
+    for (size_t l = 0; l < LOSS_LANES; ++l)
+        sum += v[l];
+    return sum;
 }
 
-inline vec<float> mse_grad(const vec<float>& target, const vec<float>& pred)
+inline void loss_clamp(loss_vec& p)
 {
-    vec<float> grad(pred.size());
-    const float scale = 2.0f / pred.size();
-    for (size_t i = 0; i < pred.size(); ++i)
-        grad[i] = scale * (pred[i] - target[i]);
-    
-    return grad;
+    const loss_vec lo = loss_vec{} + LOSS_EPS;
+    const loss_vec hi = loss_vec{} + (1.0f - LOSS_EPS);
+    p = p < lo ? lo : p;
+    p = p > hi ? hi : p;
 }
 
-// Binary Cross-Entropy loss
-inline float bce_loss(const vec<float>& pred, const vec<float>& target)
+// Fused loss kernels. apply() returns the loss of one sample of n outputs and
+// writes its gradient w.r.t. pred to grad in the same pass. grad may alias
+// pred (every element is read before it is overwritten).
+
+// Mean Squared Error
+struct mse_kernel
 {
-    float loss = 0.0f;
-    const float eps = 1e-7f;  // prevent log(0)
-    for (size_t i = 0; i < pred.size(); ++i)
+    static inline float apply(const float* pred, const float* target, float* grad, size_t n)
     {
-        const float p = std::max(std::min(pred[i], 1.0f - eps), eps);
-        loss += -(target[i] * std::log(p) + (1.0f - target[i]) * std::log(1.0f - p));
+        const float scale = 2.0f / n;
+        loss_vec acc = {};
+        size_t i = 0;
+        for (; i + LOSS_LANES <= n; i += LOSS_LANES)
+        {
+            loss_vec p, t;
+            loss_load(p, pred + i);
+            loss_load(t, target + i);
+
+            const loss_vec diff = p - t;
+            acc += diff * diff;
+            loss_store(grad + i, diff * scale);
+        }
+
+        float loss = loss_hsum(acc);
+        for (; i < n; ++i)
+        {
+            const float diff = pred[i] - target[i];
+            loss += diff * diff;
+            grad[i] = scale * diff;
+        }
+
+        return loss / n;
     }
-    return loss / pred.size();
-}
+};
 
-inline vec<float> bce_grad(const vec<float>& target, const vec<float>& pred)
+// Binary Cross-Entropy
+struct bce_kernel
 {
-    vec<float> grad(pred.size());
-    const float eps = 1e-7f;
-    const float scale = 1.0f / pred.size();
-    for (size_t i = 0; i < pred.size(); ++i)
+    static inline float apply(const float* pred, const float* target, float* grad, size_t n)
     {
-        const float p = std::max(std::min(pred[i], 1.0f - eps), eps);
-        grad[i] = scale * (p - target[i]) / (p * (1.0f - p));
+        const float scale = 1.0f / n;
+        float loss = 0.0f;
+        size_t i = 0;
+        for (; i + LOSS_LANES <= n; i += LOSS_LANES)
+        {
+            loss_vec p, t;
+            loss_load(p, pred + i);
+            loss_load(t, target + i);
+            loss_clamp(p);
+            for (size_t l = 0; l < LOSS_LANES; ++l)
+                loss -= t[l] * std::log(p[l]) + (1.0f - t[l]) * std::log(1.0f - p[l]);
+
+            loss_store(grad + i, scale * (p - t) / (p * (1.0f - p)));
+        }
+
+        for (; i < n; ++i)
+        {
+            const float p = std::clamp(pred[i], LOSS_EPS, 1.0f - LOSS_EPS);
+            loss -= target[i] * std::log(p) + (1.0f - target[i]) * std::log(1.0f - p);
+            grad[i] = scale * (p - target[i]) / (p * (1.0f - p));
+        }
+
+        return loss / n;
     }
-    return grad;
-}
+};
 
-// Categorical Cross-Entropy loss
-inline float cce_loss(const vec<float>& pred, const vec<float>& target)
+// Categorical Cross-Entropy on softmax outputs. Only classes with a nonzero
+// target contribute to the loss, so a one-hot label costs a single log.
+struct cce_kernel
 {
-    float loss = 0.0f;
-    const float eps = 1e-7f; // avoid log(0)
-    for (size_t i = 0; i < pred.size(); ++i)
+    static inline float apply(const float* pred, const float* target, float* grad, size_t n)
     {
-        float p = std::max(std::min(pred[i], 1.0f - eps), eps);
-        loss += -target[i] * std::log(p);
+        const float scale = 1.0f / n;
+        float loss = 0.0f;
+        size_t i = 0;
+        for (; i + LOSS_LANES <= n; i += LOSS_LANES)
+        {
+            loss_vec p, t;
+            loss_load(p, pred + i);
+            loss_load(t, target + i);
+            loss_clamp(p);
+            for (size_t l = 0; l < LOSS_LANES; ++l)
+            {
+                if (t[l] != 0.0f)
+                    loss -= t[l] * std::log(p[l]);
+            }
+
+            // derivative of -y*log(p) w.r.t. logits after softmax
+            loss_store(grad + i, scale * (p - t));
+        }
+
+        for (; i < n; ++i)
+        {
+            const float p = std::clamp(pred[i], LOSS_EPS, 1.0f - LOSS_EPS);
+            if (target[i] != 0.0f)
+                loss -= target[i] * std::log(p);
+            grad[i] = scale * (p - target[i]);
+        }
+
+        return loss / n;
     }
-    return loss / pred.size();
-}
+};
 
-// Gradient of Categorical Cross-Entropy wrt softmax outputs
-inline vec<float> cce_grad(const vec<float>& target, const vec<float>& pred)
+// Loss and gradient of `batch` samples stored back to back (n floats each).
+// Returns the mean or sum of the sample losses; with loss_reduction::none
+// they are also written to per_sample and the sum is returned.
+template <typename Kernel>
+inline float loss_batch(const float* pred, const float* target, float* grad, size_t batch, size_t n,
+                        loss_reduction reduction = loss_reduction::mean, float* per_sample = nullptr)
 {
-    vec<float> grad(pred.size());
-    const float eps = 1e-7f;
-    const float scale = 1.0f / pred.size();
-    for (size_t i = 0; i < pred.size(); ++i)
+    float total = 0.0f;
+    for (size_t b = 0; b < batch; ++b)
     {
-        float p = std::max(std::min(pred[i], 1.0f - eps), eps);
-        grad[i] = scale * (p - target[i]); // derivative of -y*log(p) w.r.t. logits after softmax
+        const float loss = Kernel::apply(pred + b * n, target + b * n, grad + b * n, n);
+        if (reduction == loss_reduction::none)
+            per_sample[b] = loss;
+        total += loss;
     }
-    return grad;
+
+    return reduction == loss_reduction::mean && batch ? total / batch : total;
 }
 
-// Factory function to get loss and gradient functions by name
-inline loss_pair get_loss(const std::string& name)
+enum class loss_type
+{
+    mse,
+    bce,
+    cce
+};
+
+// Loss chosen at runtime. The switch runs once per call and every branch is
+// a fully inlined kernel, so there is no indirect call per element or sample.
+struct loss_function
+{
+    loss_type type = loss_type::mse;
+
+    inline float operator()(const float* pred, const float* target, float* grad, size_t batch, size_t n,
+                            loss_reduction reduction = loss_reduction::mean, float* per_sample = nullptr) const
+    {
+        switch (type)
+        {
+        case loss_type::bce:
+            return loss_batch<bce_kernel>(pred, target, grad, batch, n, reduction, per_sample);
+        case loss_type::cce:
+            return loss_batch<cce_kernel>(pred, target, grad, batch, n, reduction, per_sample);
+        default:
+            return loss_batch<mse_kernel>(pred, target, grad, batch, n, reduction, per_sample);
+        }
+    }
+
+    // Single sample, the gradient overwrites pred
+    inline float operator()(vec<float>& pred, const vec<float>& target) const
+        { return (*this)(pred.data(), target.data(), pred.data(), 1, pred.size()); }
+};
+
+// Factory function to get a loss by name
+inline loss_function get_loss(const std::string& name)
 {
     if (name == "mse" || name == "mean-squared-error")
-        return {mse_loss, mse_grad};
-    
+        return {loss_type::mse};
+
     else if (name == "bce" || name == "binary-cross-entropy")
-        return {bce_loss, bce_grad};
-    
+        return {loss_type::bce};
+
     else if (name == "cce" || name == "categorical-cross-entropy")
-        return {cce_loss, cce_grad};
-    
+        return {loss_type::cce};
+
     // Default to MSE if unknown
-    return {mse_loss, mse_grad};
+    return {loss_type::mse};
 }
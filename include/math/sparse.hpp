@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include "math/vec_utils.hpp"
+
+// Columns per block of the blocked-CSR format. Blocks are one row high so a
+// block's weights multiply one contiguous run of the input, which maps onto
+// one 8-wide vector operation.
+#define BCSR_BLOCK 8
+
+typedef float bcsr_vec __attribute__((vector_size(BCSR_BLOCK * sizeof(float))));
+
+// Blocked compressed sparse row matrix: only 1 x BCSR_BLOCK blocks holding a
+// nonzero are stored
+struct bcsr_matrix
+{
+    size_t rows = 0;
+    size_t cols = 0;
+    vec<uint32_t> row_ptr;   // blocks of row r are [row_ptr[r], row_ptr[r + 1])
+    vec<uint32_t> block_col; // first column of each block, a multiple of BCSR_BLOCK
+    vec<bcsr_vec> values;    // BCSR_BLOCK weights per block
+
+    // Fraction of the dense matrix that is stored
+    inline float density() const
+        { return rows && cols ? (float)values.size() * BCSR_BLOCK / (rows * cols) : 0.0f; }
+};
+
+// Dense is anything indexed as dense[row][col] with a size() of rows
+template <typename Dense>
+inline bcsr_matrix to_bcsr(const Dense& dense)
+{
+    bcsr_matrix m;
+    m.rows = dense.size();
+    m.cols = m.rows ? dense[0].size() : 0;
+    m.row_ptr.push_back(0);
+
+    for (size_t r = 0; r < m.rows; ++r)
+    {
+        const auto& row = dense[r];
+        for (size_t c = 0; c < m.cols; c += BCSR_BLOCK)
+        {
+            bcsr_vec block = {};
+            bool nonzero = false;
+            for (size_t k = 0; k < BCSR_BLOCK && c + k < m.cols; ++k)
+            {
+                block[k] = row[c + k];
+                nonzero |= row[c + k] != 0.0f;
+            }
+
+            if (nonzero)
+            {
+                m.block_col.push_back(c);
+                m.values.push_back(block);
+            }
+        }
+        m.row_ptr.push_back(m.values.size());
+    }
+
+    return m;
+}
+
+// y[r] = b[r] + sum_c m[r][c] * x[c]. x must hold at least cols rounded up to
+// a multiple of BCSR_BLOCK floats, the padding must be zero.
+inline void bcsr_gemv(const bcsr_matrix& m, const float* x, const float* b, float* y) noexcept
+{
+    for (size_t r = 0; r < m.rows; ++r)
+    {
+        bcsr_vec acc = {};
+        for (uint32_t k = m.row_ptr[r]; k < m.row_ptr[r + 1]; ++k)
+        {
+            bcsr_vec xv;
+            __builtin_memcpy(&xv, x + m.block_col[k], sizeof(xv));
+            acc += m.values[k] * xv;
+        }
+
+        float sum = 0.0f;
+        for (size_t k = 0; k < BCSR_BLOCK; ++k)
+            sum += acc[k];
+        y[r] = sum + b[r];
+    }
+}
+
+// Y[n][r] = b[r] + sum_c m[r][c] * X[n][c] for a batch of n inputs, rows of X
+// padded to ld floats as for bcsr_gemv. Each block is loaded once per batch.
+inline void bcsr_gemm(const bcsr_matrix& m, const float* X, size_t n, size_t ld, const float* b, float* Y) noexcept
+{
+    vec<bcsr_vec> acc(n);
+    for (size_t r = 0; r < m.rows; ++r)
+    {
+        std::fill(acc.begin(), acc.end(), bcsr_vec{});
+        for (uint32_t k = m.row_ptr[r]; k < m.row_ptr[r + 1]; ++k)
+        {
+            const bcsr_vec w = m.values[k];
+            for (size_t i = 0; i < n; ++i)
+            {
+                bcsr_vec xv;
+                __builtin_memcpy(&xv, X + i * ld + m.block_col[k], sizeof(xv));
+                acc[i] += w * xv;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            float sum = 0.0f;
+            for (size_t k = 0; k < BCSR_BLOCK; ++k)
+                sum += acc[i][k];
+            Y[i * m.rows + r] = sum + b[r];
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <cmath>
 #include <cstdint>
@@ -17,7 +18,7 @@ using vec3 = std::vector<std::vector<std::vector<T>>>;
 // 1D vector operations
 // =====================
 
-inline float mult_add(const vec<float>& a, const vec<float>& b, float c) noexcept
+inline float mult_add(std::span<const float> a, std::span<const float> b, float c) noexcept
 {
     float sum = 0.00f;
     for (size_t i = 0; i < a.size(); ++i)
@@ -26,6 +27,37 @@ inline float mult_add(const vec<float>& a, const vec<float>& b, float c) noexcep
     return sum + c;
 }
 
+// Dot product of the sparse vector (idx, val) with b
+inline float sparse_mult_add(const vec<uint32_t>& idx, const vec<float>& val, std::span<const float> b, float c) noexcept
+{
+    float sum = 0.00f;
+    for (size_t k = 0; k < idx.size(); ++k)
+        sum += val[k] * b[idx[k]];
+
+    return sum + c;
+}
+
+// Write a as base plus the sparse vector (idx, val) of the entries that
+// differ from base. Gives up once more than max_count differ, returns
+// whether they all fit.
+inline bool split_sparse(std::span<const float> a, float base, size_t max_count, vec<uint32_t>& idx, vec<float>& val)
+{
+    idx.clear();
+    val.clear();
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i] == base)
+            continue;
+        if (idx.size() == max_count)
+            return false;
+
+        idx.push_back(i);
+        val.push_back(a[i] - base);
+    }
+
+    return true;
+}
+
 // =====================
 // 2D vector operations
 // =====================
@@ -41,3 +73,87 @@ inline vec<float> mult_add2(const vec2<float>& a, const vec2<float>& b, const ve
     
     return sum;
 }
+
+// =====================
+// GEMM (row-major, flat buffers)
+// =====================
+
+// C[M x N] += A[M x K] * B[K x N]
+inline void gemm_nn(size_t M, size_t N, size_t K, const float* A, const float* B, float* C) noexcept
+{
+    for (size_t i = 0; i < M; ++i)
+    {
+        float* c = C + i * N;
+        for (size_t k = 0; k < K; ++k)
+        {
+            const float a = A[i * K + k];
+            const float* b = B + k * N;
+            for (size_t j = 0; j < N; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+// gemm_nn over tile x tile panels of B so each panel stays in cache while
+// every row of A uses it. Sums in the same order as gemm_nn; tile 0 is gemm_nn.
+inline void gemm_nn_tiled(size_t M, size_t N, size_t K, const float* A, const float* B, float* C, size_t tile) noexcept
+{
+    if (tile == 0)
+    {
+        gemm_nn(M, N, K, A, B, C);
+        return;
+    }
+
+    for (size_t k0 = 0; k0 < K; k0 += tile)
+    {
+        const size_t k1 = std::min(k0 + tile, K);
+        for (size_t j0 = 0; j0 < N; j0 += tile)
+        {
+            const size_t j1 = std::min(j0 + tile, N);
+            for (size_t i = 0; i < M; ++i)
+            {
+                float* c = C + i * N;
+                for (size_t k = k0; k < k1; ++k)
+                {
+                    const float a = A[i * K + k];
+                    const float* b = B + k * N;
+                    for (size_t j = j0; j < j1; ++j)
+                        c[j] += a * b[j];
+                }
+            }
+        }
+    }
+}
+
+// C[M x N] += A[M x K] * B[N x K]^T
+inline void gemm_nt(size_t M, size_t N, size_t K, const float* A, const float* B, float* C) noexcept
+{
+    for (size_t i = 0; i < M; ++i)
+    {
+        const float* a = A + i * K;
+        for (size_t j = 0; j < N; ++j)
+        {
+            const float* b = B + j * K;
+            float sum = 0.0f;
+            for (size_t k = 0; k < K; ++k)
+                sum += a[k] * b[k];
+            C[i * N + j] += sum;
+        }
+    }
+}
+
+// C[M x N] += A[K x M]^T * B[K x N]
+inline void gemm_tn(size_t M, size_t N, size_t K, const float* A, const float* B, float* C) noexcept
+{
+    for (size_t k = 0; k < K; ++k)
+    {
+        const float* b = B + k * N;
+        for (size_t i = 0; i < M; ++i)
+        {
+            const float a = A[k * M + i];
+            float* c = C + i * N;
+            for (size_t j = 0; j < N; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
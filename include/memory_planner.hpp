@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include "math/vec_utils.hpp"
+
+// Buffer offsets are rounded to 64 bytes so every buffer starts on a cache line
+#define PLAN_ALIGN 16
+
+// One region of the slab. Buffers whose lifetimes overlap never share memory.
+struct buffer_plan
+{
+    std::string name;
+    size_t size;      // floats
+    size_t offset;    // floats from the start of the slab
+    size_t first_use; // schedule step that writes the buffer
+    size_t last_use;  // last schedule step that reads it
+};
+
+struct memory_plan
+{
+    vec<buffer_plan> buffers;
+    vec<size_t> activations; // buffer holding activation l, [0] is the network input
+    vec<size_t> gradients;   // buffer holding d loss / d activation l, SIZE_MAX if not planned
+    size_t slab_size = 0;    // floats
+    size_t naive_size = 0;   // floats if every activation and gradient was its own vector
+};
+
+// Assign activation (and for training, gradient) buffers to offsets in one slab.
+//
+// The schedule runs layer l forward at step l and, when training, the loss at
+// step L and layer l backward at step 2L - l, which reads activations l and
+// l + 1 and the gradient of l + 1 and writes the gradient of l. sizes has
+// L + 1 entries (network input plus each layer output). inplace[l] allows
+// layer l to overwrite its input: its input activation in inference, the
+// gradient it receives in training, where backward still reads both
+// activations. Gradients are planned for activations first_grad .. L only,
+// the earlier ones feed no layer with parameters.
+memory_plan plan_memory(const vec<size_t>& sizes, const vec<bool>& inplace, bool training = false,
+                        size_t first_grad = 1);
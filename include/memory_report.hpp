@@ -0,0 +1,62 @@
+#pragma once
+
+#include <iosfwd>
+#include "nn.hpp"
+#include "numa_memory.hpp"
+
+// Allocations made so far by numa_alloc plus every count_allocation() call.
+// The operator new replacements in alloc_hooks.cpp make that call, in
+// programs that link it; elsewhere operator new goes uncounted.
+size_t allocation_count();
+void count_allocation();
+
+struct process_memory
+{
+    size_t rss = 0;
+    size_t peak_rss = 0;    // since start or the last reset_peak_rss()
+    size_t heap_in_use = 0; // malloc'd and not freed
+    size_t heap_free = 0;   // held by malloc for reuse, the allocator's own overhead
+    size_t allocations = 0; // allocation_count()
+    memory_stats numa;
+};
+
+process_memory get_process_memory();
+
+// Restart the kernel's peak RSS mark, false where /proc/self/clear_refs is
+// not writable (peak_rss then stays the process-wide peak)
+bool reset_peak_rss();
+
+struct epoch_memory
+{
+    size_t epoch = 0;
+    size_t allocations = 0; // made during the epoch
+    size_t rss = 0;         // at the end of the epoch
+    size_t peak_rss = 0;    // highest during the epoch
+};
+
+// Wraps one training epoch: begin() before it, end() after. An epoch is the
+// finest grain that makes sense here, its batches run concurrently.
+class epoch_memory_tracker
+{
+    size_t start_allocations = 0;
+
+public:
+    void begin();
+    epoch_memory end(size_t epoch);
+};
+
+struct memory_report
+{
+    vec<layer_memory> layers; // NeuralNetwork::memory_usage()
+    dataset_memory dataset;
+    process_memory process;
+    vec<epoch_memory> epochs;
+};
+
+memory_report make_memory_report(const NeuralNetwork& nn, const dataset_t& dataset);
+
+// Per-layer table in KB followed by dataset and process totals
+void write_memory_table(std::ostream& os, const memory_report& report);
+
+// The whole report, epochs included, in bytes
+void write_memory_json(std::ostream& os, const memory_report& report);
@@ -1,31 +1,67 @@
 #pragma once
 
 #include <random>
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <fstream>
+#include <optional>
+#include <span>
 
 #include "layers/basic_layer.hpp"
 #include "math/dataset.hpp"
+#include "math/dataset_view.hpp"
 #include "math/losses.hpp"
+#include "memory_planner.hpp"
+#include "numa_memory.hpp"
+
+// Samples test() runs through infer_batch() at once
+#define TEST_BATCH 32
 
 class NeuralNetwork
 {
     vec<basic_layer *> layers;
-    loss_pair loss_functions;
+    loss_function loss_fn;
 
     std::random_device rd{};
     std::shared_ptr<std::mt19937> gen;
 
+    // Activation slab for infer() and infer_batch(), set up by compile().
+    // Every planned buffer holds compiled_batch samples one after another.
+    memory_plan compiled_plan;
+    size_t compiled_batch = 0;
+    numa_buffer slab;
+    float* slab_base = nullptr;
+
+    // Activation and gradient slabs for training, one per backprop() thread
+    memory_plan training_plan;
+    vec<numa_buffer> training_slabs;
+    void prepare_training(size_t input_size, size_t threads);
+    float* training_slab(size_t thread);
+
+    // Bumped whenever the parameters may have changed
+    std::atomic<uint64_t> weights_version{0};
+
+    // The SGD loop of train_range(), run by every backprop() thread on its
+    // own slab. Layers train on the planned buffers through train_into() and
+    // backprop_into() instead of keeping copies of their inputs.
+    float train_samples(const dataset_view& dataset, size_t start, size_t end, float* slab);
+
 public:
-    NeuralNetwork(vec<basic_layer *> layers_={}, const std::string& loss_type="mse");
+    // Takes ownership of the layers
+    NeuralNetwork(vec<basic_layer *> layers_={}, const std::string& loss_type="mse", std::optional<uint32_t> seed={});
     ~NeuralNetwork();
 
     void add_layer(basic_layer* layer)
     {
         layer->set_gen(gen);
 
+        // Input gradients only matter if an earlier layer trains on them
+        layer->set_input_grads(std::any_of(layers.begin(), layers.end(),
+                                           [](const basic_layer* l) { return l->has_params(); }));
+
         if (layers.size() != 0)
             layer->init(layers[layers.size() - 1]->get_size());
         else
@@ -34,12 +70,96 @@ public:
         layers.push_back(layer);
     }
 
+    inline const vec<basic_layer *>& get_layers() const
+        { return layers; }
+
+    inline const loss_function& get_loss_function() const
+        { return loss_fn; }
+
     vec<float> forward(vec<float> in);
-    float backprop(const dataset_t& dataset);
+    float backprop(const dataset_view& dataset);
+
+    // Sequential SGD over samples [start, end), returns the summed loss
+    float train_range(const dataset_view& dataset, size_t start, size_t end);
+
+    // Bracket training that calls forward() and backprop() on the layers
+    // directly, with no other thread using the network. backprop() and
+    // train_range() do this themselves.
+    void begin_training();
+    void end_training();
+
+    // Views of every trainable parameter buffer, in layer order. The views
+    // are writable, so this counts as a weight change.
+    vec<std::span<float>> get_params();
+
+    // Views of every non-trainable state buffer, in layer order. Writable like
+    // get_params(), so this counts as a weight change too.
+    vec<std::span<float>> get_buffers();
+
+    // Read-only get_params() and get_buffers(), no weight change
+    vec<std::span<const float>> view_params() const;
+    vec<std::span<const float>> view_buffers() const;
+
+    // Changes whenever training, pruning or get_params() may have changed
+    // what the network computes; caches of its outputs compare against it
+    inline uint64_t get_weights_version() const
+        { return weights_version.load(std::memory_order_acquire); }
+    inline void mark_weights_changed()
+        { weights_version.fetch_add(1, std::memory_order_acq_rel); }
 
-    float test(const dataset_t& test);
+    // Bytes held by every layer, in layer order, followed by one "network"
+    // entry for the compiled inference slab and the training slabs
+    vec<layer_memory> memory_usage() const;
+
+    float test(const dataset_view& test);
+
+    // Zero the smallest-magnitude weights of every linear layer and keep them
+    // at zero through later training. structured prunes whole BCSR blocks.
+    void prune(float sparsity, bool structured = false);
+
+    // Switch pruned layers to block-sparse inference; redo after the weights change
+    void compress();
+
+    // Per-node weight copies for inference on multi-socket machines
+    void replicate();
+
+    // Width of every activation, [0] is the network input
+    vec<size_t> infer_shapes(size_t input_size);
+
+    // Plan the activation memory of an inference pass over the layers, or the
+    // activation and gradient memory of a training step
+    memory_plan plan(size_t input_size, bool training = false);
+
+    // Preallocate one slab for all inference activations of up to `batch`
+    // samples, reused by infer() and infer_batch()
+    const memory_plan& compile(size_t input_size, size_t batch = 1);
+
+    // forward() through the compiled slab without per-layer allocations.
+    // The result points into the slab and is valid until the next call;
+    // not safe to call from several threads at once.
+    std::span<const float> infer(std::span<const float> in);
+
+    // infer() on samples [start, start + count) of data at once, so layers
+    // can read their weights once per batch. Returns the count outputs one
+    // after another, valid like infer()'s.
+    std::span<const float> infer_batch(const dataset_view& data, size_t start, size_t count);
+
+    // Write a self-contained header with the weights as constexpr arrays and
+    // an infer() specialized for this topology, for deployment without this library
+    void export_header(std::ostream& os, size_t input_size, const std::string& ns = "nn_model");
 };
 
+// Gradual pruning schedule (Zhu & Gupta): sparsity ramps up cubically from 0
+// to final_sparsity over `steps` steps, pruning fast while redundancy is high
+inline float prune_schedule(float final_sparsity, size_t step, size_t steps)
+{
+    if (steps == 0 || step >= steps)
+        return final_sparsity;
+
+    float remaining = 1.0f - (float)step / steps;
+    return final_sparsity * (1.0f - remaining * remaining * remaining);
+}
+
 // Return the index of the largest value in a vector
 inline int argmax(const vec<float>& data)
 {
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <iosfwd>
+#include "math/vec_utils.hpp"
+
+// Buffers from this size up are mapped directly, smaller ones come from the heap
+#define NUMA_MIN_MAP_BYTES (64 * 1024)
+
+// Transparent and explicit huge pages on x86-64
+#define HUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+struct memory_config_t
+{
+    // "none": 4 KB pages, "thp": madvise(MADV_HUGEPAGE),
+    // "hugetlb": MAP_HUGETLB from the reserved pool, falling back to thp.
+    // Either huge page setting only applies to buffers of HUGE_PAGE_BYTES
+    // and up, smaller ones would mostly be padding.
+    std::string pages = "none";
+
+    // "first-touch": pages land on the node of the thread that first writes
+    // them, right for per-thread workspaces. "interleave": pages round-robin
+    // over all nodes, right for weights every training thread reads.
+    std::string placement = "first-touch";
+};
+
+// Applies to allocations made after the call
+void set_memory_config(const memory_config_t& cfg);
+const memory_config_t& get_memory_config();
+
+// CPUs of every NUMA node, empty when the system does not expose them
+vec<vec<int>> numa_nodes();
+
+// Node of the calling thread's current CPU
+int current_numa_node();
+
+// Zeroed memory placed by the current memory_config_t. node >= 0 binds the
+// pages to that node instead.
+void* numa_alloc(size_t bytes, int node = -1);
+void numa_free(void* p, size_t bytes);
+
+// What an allocation of `bytes` at p really holds: the whole mapping for
+// mapped buffers, `bytes` for heap ones
+size_t numa_allocated_bytes(const void* p, size_t bytes);
+
+struct memory_stats
+{
+    size_t allocations = 0;
+    size_t mapped_bytes = 0;  // live bytes in direct mappings
+    size_t hugetlb_bytes = 0; // part of mapped_bytes backed by MAP_HUGETLB
+    size_t heap_bytes = 0;    // live bytes from the heap
+};
+
+memory_stats get_memory_stats();
+
+// Fixed-size float buffer from numa_alloc, for parameters and workspaces
+class numa_buffer
+{
+    float* ptr = nullptr;
+    size_t n = 0;
+    int node = -1; // kept so copies are bound to the same node
+
+public:
+    numa_buffer() = default;
+    explicit numa_buffer(size_t size, int node = -1);
+    ~numa_buffer();
+
+    numa_buffer(const numa_buffer& other);
+    numa_buffer(numa_buffer&& other) noexcept;
+    numa_buffer& operator=(numa_buffer other) noexcept;
+
+    inline float* data() { return ptr; }
+    inline const float* data() const { return ptr; }
+    inline size_t size() const { return n; }
+    inline bool empty() const { return n == 0; }
+    inline size_t allocated_bytes() const { return numa_allocated_bytes(ptr, n * sizeof(float)); }
+    inline float& operator[](size_t i) { return ptr[i]; }
+    inline const float& operator[](size_t i) const { return ptr[i]; }
+    inline float* begin() { return ptr; }
+    inline float* end() { return ptr + n; }
+    inline const float* begin() const { return ptr; }
+    inline const float* end() const { return ptr + n; }
+};
+
+// Row-major rows x cols matrix in one numa_buffer, indexed like a vec2
+class numa_matrix
+{
+    numa_buffer buf;
+    size_t num_rows = 0;
+    size_t num_cols = 0;
+
+public:
+    numa_matrix() = default;
+    numa_matrix(size_t rows, size_t cols, int node = -1) : buf(rows * cols, node), num_rows(rows), num_cols(cols) {}
+
+    inline std::span<float> operator[](size_t r)
+        { return { buf.data() + r * num_cols, num_cols }; }
+    inline std::span<const float> operator[](size_t r) const
+        { return { buf.data() + r * num_cols, num_cols }; }
+
+    inline size_t size() const { return num_rows; }
+    inline size_t cols() const { return num_cols; }
+    inline bool empty() const { return num_rows == 0; }
+    inline size_t allocated_bytes() const { return buf.allocated_bytes(); }
+    inline float* data() { return buf.data(); }
+    inline const float* data() const { return buf.data(); }
+    inline std::span<float> flat() { return { buf.data(), buf.size() }; }
+};
+
+// Hardware counters and page placement of this process, for judging the
+// effect of the settings above. Counters that the kernel refuses to open
+// (e.g. perf_event_paranoid) are reported as unavailable.
+class memory_profiler
+{
+    int fds[4] = { -1, -1, -1, -1 }; // dTLB loads, dTLB misses, node loads, node misses
+
+public:
+    memory_profiler();
+    ~memory_profiler();
+
+    void start();
+    void stop();
+
+    // Prints TLB miss and remote-node access rates plus resident pages per node
+    void report(std::ostream& os) const;
+};
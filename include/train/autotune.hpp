@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "nn.hpp"
+
+struct autotune_config_t
+{
+    std::string cache_path = "autotune.cache";
+    size_t samples = 256;              // training samples each candidate is timed on
+    size_t repeats = 3;                // timings per candidate, the fastest counts
+    vec<ushort> batch_candidates = {}; // num_batches to try, empty for powers of two up to 4x the cores
+    bool force = false;                // benchmark even when the cache has an answer
+};
+
+struct autotune_result
+{
+    ushort num_batches = 1;
+    size_t tuned = 0;  // settings benchmarked on this run
+    size_t cached = 0; // settings loaded from the cache
+};
+
+// "model name" from /proc/cpuinfo plus the hardware thread count
+std::string cpu_model();
+
+// Tuning winners on disk, one "cpu <tab> key <tab> value" line each. Entries
+// of other machines are kept, so one file can serve a whole fleet.
+class tuning_cache
+{
+    std::string path;
+    std::map<std::pair<std::string, std::string>, std::string> entries;
+
+public:
+    explicit tuning_cache(std::string path);
+
+    bool get(const std::string& cpu, const std::string& key, std::string& value) const;
+    void set(const std::string& cpu, const std::string& key, const std::string& value);
+
+    // Write through a temporary file and rename, so readers never see a partial file
+    void save() const;
+};
+
+// Pick the fastest kernel variant for every distinct layer shape of nn and
+// the fastest num_batches for training it, timed on real samples of
+// `dataset`. Winners are looked up in and written to the cache file, keyed by
+// cpu_model(). Parameters are restored afterwards, so tuning never changes
+// what the network has learned. Speed is all that is measured: num_batches
+// also changes how Hogwild training converges.
+autotune_result autotune(NeuralNetwork& nn, const dataset_view& dataset, const autotune_config_t& cfg = {});
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <condition_variable>
+#include <stop_token>
+#include "nn.hpp"
+#include "train/snapshot.hpp"
+
+struct checkpoint_config_t
+{
+    std::string dir = "checkpoints";
+    size_t keep = 3;                             // newest checkpoints kept on disk
+    size_t max_bytes_per_sec = 64 * 1024 * 1024; // write rate limit, 0 for unlimited
+};
+
+// Periodic checkpoints written by a background thread.
+//
+// save() only copies the parameters into a preallocated buffer on the
+// caller's thread; serialization, fsync and rotation happen on the writer.
+// If the writer is still busy when the next save() arrives, the newer
+// checkpoint replaces the one waiting to be written.
+class checkpointer
+{
+    checkpoint_config_t cfg;
+
+    std::mutex mtx;
+    std::condition_variable_any cv;
+    std::condition_variable_any idle;
+    param_snapshot pending; // filled by save()
+    param_snapshot writing; // owned by the writer thread
+    bool has_pending = false;
+    bool busy = false;
+
+    // time save() kept the caller away from training
+    double stall_total_us = 0.0;
+    double stall_max_us = 0.0;
+    size_t saves = 0;
+
+    std::jthread writer;
+
+    void run(std::stop_token stop);
+    void write(const param_snapshot& snap);
+    void rotate();
+
+public:
+    checkpointer(checkpoint_config_t cfg = {});
+    ~checkpointer();
+
+    // Snapshot nn's parameters as checkpoint number `step` and queue it
+    void save(const NeuralNetwork& nn, uint64_t step);
+
+    // Block until every queued checkpoint is on disk
+    void flush();
+
+    inline double get_mean_stall_us() const
+        { return saves ? stall_total_us / saves : 0.0; }
+    inline double get_max_stall_us() const
+        { return stall_max_us; }
+
+    // Load the newest intact checkpoint in dir that fits nn's topology into
+    // nn, returns its step. Damaged or mismatched files are skipped.
+    static std::optional<uint64_t> resume(NeuralNetwork& nn, const std::string& dir);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include "nn.hpp"
+#include "train/ring_allreduce.hpp"
+
+struct data_parallel_config_t
+{
+    int world = 1;
+    size_t step_size = 256; // samples per global step, split evenly across ranks
+    std::string socket_path = "/tmp/nn-ring";
+    bool pin_numa = true;
+};
+
+// Synchronous data-parallel SGD. Every rank starts a step from the same
+// parameters, runs sequential SGD over its slice of the step, then the
+// parameter deltas are summed with a ring all-reduce and applied everywhere.
+//
+// Reproducibility: every rank starts from DATA_PARALLEL_SEED weights and the
+// reduction order depends only on the world size, so runs repeat bit for bit
+// for the same N. They are not bit-compatible with single-process training:
+// each rank's SGD over its slice of a step starts from the step's weights,
+// which is a different computation from one pass of sequential SGD, so
+// results also differ between world sizes.
+class data_parallel_trainer
+{
+    NeuralNetwork& nn;
+    ring_allreduce& ring;
+    size_t local_step;
+
+    vec<float> base;  // parameters at the start of the step
+    vec<float> delta; // local update, then the summed update
+
+public:
+    data_parallel_trainer(NeuralNetwork& nn, ring_allreduce& ring, size_t step_size);
+
+    // One pass over this rank's shard, returns the mean loss across all ranks
+    float train_epoch(const dataset_view& shard);
+};
+
+// Fork world processes running fn(rank, world) and wait for all of them. If a
+// fork fails or a rank exits with an error, the other ranks are terminated
+// and reaped and 1 is returned.
+// With pin_numa, ranks are spread round-robin over the NUMA nodes before fn
+// runs, so every allocation a rank makes lands on its own memory controller.
+int launch_data_parallel(int world, const std::function<int(int, int)>& fn, bool pin_numa = true);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include "nn.hpp"
+#include "train/spsc_queue.hpp"
+
+struct pipeline_config_t
+{
+    size_t stages = 2;       // worker threads, each owning a contiguous range of layers
+    size_t micro_batch = 8;  // samples per message between stages
+    size_t queue_depth = 16; // messages buffered between neighbouring stages
+    bool pin = true;         // pin stage s to core s so its weights stay in that core's cache
+};
+
+// Runs contiguous ranges of a network's layers on separate threads, passing
+// micro-batches between them through lock-free SPSC queues.
+//
+// Training uses a 1F1B schedule: stage s keeps at most (stages - s) micro-
+// batches in flight and prefers backward work whenever some is queued. Each
+// stage stashes only its input and recomputes its forward pass right before
+// backward (as in GPipe), since layers cache a single sample's activations.
+// Weights are updated as gradients arrive, so a micro-batch's backward can
+// see weights a few steps newer than its forward did.
+class pipeline_executor
+{
+    struct message
+    {
+        size_t id;
+        vec<vec<float>> data;
+    };
+
+    NeuralNetwork& nn;
+    pipeline_config_t cfg;
+    vec<size_t> bounds; // stage s runs layers [bounds[s], bounds[s + 1])
+
+    vec<std::unique_ptr<spsc_queue<message>>> fwd; // stage s -> s + 1
+    vec<std::unique_ptr<spsc_queue<message>>> bwd; // stage s + 1 -> s
+
+    vec<float> forward_range(size_t s, vec<float> x);
+    vec<float> backward_range(size_t s, vec<float> grad, dataset_config_t config);
+
+    void stage_loop(size_t s, size_t num_micro, const dataset_view* train,
+                    const vec<vec<float>>* inputs, vec<vec<float>>* outputs, float* loss);
+    void run(size_t num_samples, const dataset_view* train, const vec<vec<float>>* inputs,
+             vec<vec<float>>* outputs, float* loss);
+
+public:
+    pipeline_executor(NeuralNetwork& nn, pipeline_config_t cfg = {});
+
+    // One pass over the dataset, returns the mean loss
+    float train(const dataset_view& dataset);
+
+    // Forward every input through the pipeline, outputs keep the input order
+    vec<vec<float>> infer(const vec<vec<float>>& inputs);
+
+    inline const vec<size_t>& get_bounds() const
+        { return bounds; }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include "math/vec_utils.hpp"
+
+// Ring all-reduce between the processes of one machine over Unix domain sockets.
+// Rank r receives from rank r-1 and sends to rank r+1, so every link carries
+// 2*(world-1)/world of the buffer per call regardless of the process count.
+class ring_allreduce
+{
+    int rank;
+    int world;
+    int send_fd = -1; // connection to rank + 1
+    int recv_fd = -1; // connection from rank - 1
+    std::string path;
+
+    vec<float> scratch;
+
+    void exchange(const float* send, size_t send_n, float* recv, size_t recv_n);
+
+public:
+    // Connects to both neighbours, throws if they do not show up in time
+    ring_allreduce(const std::string& path, int rank, int world);
+    ~ring_allreduce();
+
+    ring_allreduce(const ring_allreduce&) = delete;
+    ring_allreduce& operator=(const ring_allreduce&) = delete;
+
+    inline int get_rank() const
+        { return rank; }
+
+    inline int get_world() const
+        { return world; }
+
+    // Replace data with the elementwise sum over all ranks. The summation order
+    // only depends on the world size, so every rank ends up with identical bits.
+    void allreduce(std::span<float> data);
+
+    // Block until every rank has reached the barrier
+    void barrier();
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <stop_token>
+#include "nn.hpp"
+
+// Immutable copy of a network's parameters, one buffer per get_params() span
+// followed by one per get_buffers() span
+struct param_snapshot
+{
+    vec<vec<float>> buffers;
+    uint64_t version = 0;
+};
+
+// Copy the parameters of nn into snap, reusing its storage
+void save_params(const NeuralNetwork& nn, param_snapshot& snap);
+
+// Whether snap was taken from a network with nn's topology
+bool matches_topology(const NeuralNetwork& nn, const param_snapshot& snap);
+
+// Overwrite the parameters of nn, which must have the same topology
+void load_params(NeuralNetwork& nn, const param_snapshot& snap);
+
+// Single-writer, many-reader publication of parameter snapshots (RCU style).
+// Readers grab the latest snapshot with one atomic load and keep it alive for
+// as long as they need it; the writer never waits for them. Two buffers
+// alternate so steady-state publishing does not allocate.
+class snapshot_channel
+{
+    std::atomic<std::shared_ptr<const param_snapshot>> latest;
+    std::shared_ptr<param_snapshot> spare; // writer-owned, reused once readers let go
+    uint64_t version = 0;
+
+    std::mutex mtx;
+    std::condition_variable_any cv;
+
+public:
+    // Copy nn's current parameters and make them the latest snapshot
+    void publish(const NeuralNetwork& nn);
+
+    inline std::shared_ptr<const param_snapshot> get() const
+        { return latest.load(std::memory_order_acquire); }
+
+    // Block until a snapshot newer than `seen` exists or stop is requested
+    std::shared_ptr<const param_snapshot> wait_newer(uint64_t seen, std::stop_token stop);
+
+    // Hot-swap nn to the latest snapshot if it is newer than `loaded`.
+    // Call it between requests on the thread that runs nn.
+    bool refresh(NeuralNetwork& nn, uint64_t& loaded);
+};
+
+// Scores every new snapshot on a validation set from a background thread,
+// using its own network instance so training never pauses.
+class async_validator
+{
+    NeuralNetwork& eval_nn;
+    snapshot_channel& channel;
+    dataset_view validation;
+    std::function<void(uint64_t, float)> on_result;
+
+    std::atomic<float> last_accuracy{0.0f};
+    std::atomic<uint64_t> last_version{0};
+    std::jthread worker;
+
+    void run(std::stop_token stop);
+
+public:
+    // eval_nn must have the same topology as the network being published
+    async_validator(NeuralNetwork& eval_nn, snapshot_channel& channel, const dataset_view& validation,
+                    std::function<void(uint64_t, float)> on_result = {});
+    ~async_validator();
+
+    inline float get_accuracy() const
+        { return last_accuracy.load(); }
+    inline uint64_t get_version() const
+        { return last_version.load(); }
+
+    // Wait until the snapshot with the given version has been scored
+    void wait_for(uint64_t version);
+};
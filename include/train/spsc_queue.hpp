@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "math/vec_utils.hpp"
+
+// Bounded lock-free single-producer single-consumer ring buffer
+template <typename T>
+class spsc_queue
+{
+    vec<T> buf;
+    size_t mask;
+
+    // producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> head{0}; // next slot to read
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to write
+
+public:
+    // capacity is rounded up to a power of two
+    explicit spsc_queue(size_t capacity)
+    {
+        size_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        buf.resize(cap);
+        mask = cap - 1;
+    }
+
+    bool try_push(T&& item)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask)
+            return false;
+
+        buf[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side: try_push would fail right now
+    bool full() const
+        { return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) > mask; }
+
+    bool try_pop(T& item)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(buf[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T&& item)
+    {
+        while (!try_push(std::move(item)))
+            std::this_thread::yield();
+    }
+};
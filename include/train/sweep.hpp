@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include "nn.hpp"
+
+// One configuration of a hyperparameter sweep
+struct sweep_trial_t
+{
+    std::string name;
+    float lr = 0.01f;
+    vec<size_t> widths = { 32, 16 }; // hidden dense layers
+    std::string activation = "tanh";
+    std::string loss = "cce";
+};
+
+struct sweep_config_t
+{
+    size_t threads = 0;              // trials trained at once, 0 for one per hardware thread
+    size_t min_epochs = 2;           // epochs every trial gets before the first cut
+    size_t max_epochs = 50;
+    size_t eta = 2;                  // each rung keeps 1 / eta of the trials and trains them eta times longer
+    float validation_fraction = 0.1f;
+    uint32_t seed = 42;              // same split and initial weights for every trial
+};
+
+struct sweep_result_t
+{
+    sweep_trial_t trial;
+    size_t epochs = 0;
+    size_t rung = 0;       // last successive-halving rung the trial reached
+    bool finished = false; // survived every cut
+    float loss = 0.0f;     // training loss of the last epoch
+    float accuracy = 0.0f; // on the held-out split after the last epoch
+    double seconds = 0.0;  // time spent training and evaluating it
+};
+
+// Normalize, then the hidden widths, then a softmax layer of output_size.
+// main's model is a default sweep_trial_t built with this.
+std::unique_ptr<NeuralNetwork> build_trial_model(const sweep_trial_t& trial, size_t input_size, size_t output_size,
+                                                 std::optional<uint32_t> seed = {});
+
+// Train every trial on one shared dataset with successive halving: all trials
+// train min_epochs, the best 1 / eta by validation accuracy continue to
+// eta * min_epochs, and so on until one is left or max_epochs is reached.
+// Trials run concurrently, one thread each (num_batches is forced to 1), and
+// only read the dataset through views. Results are sorted best first.
+vec<sweep_result_t> run_sweep(const dataset_view& dataset, const vec<sweep_trial_t>& trials,
+                              const sweep_config_t& cfg = {});
+
+// Aligned text table of the results
+void write_sweep_table(std::ostream& os, const vec<sweep_result_t>& results);
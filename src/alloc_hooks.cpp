@@ -0,0 +1,59 @@
+// Replacements of the global allocation functions that feed
+// allocation_count(). Linked into the nn binary only, so programs and tests
+// built on the library keep the standard allocator.
+
+#include <new>
+#include <cstdlib>
+#include "memory_report.hpp"
+
+// Identical to the library's apart from the counting. The array and nothrow
+// forms forward to these.
+void* operator new(size_t bytes)
+{
+    count_allocation();
+    for (;;)
+    {
+        if (void* p = std::malloc(bytes ? bytes : 1))
+            return p;
+        if (std::new_handler handler = std::get_new_handler())
+            handler();
+        else
+            throw std::bad_alloc();
+    }
+}
+
+void* operator new(size_t bytes, std::align_val_t align)
+{
+    count_allocation();
+    const size_t a = (size_t)align;
+    for (;;)
+    {
+        // aligned_alloc wants a multiple of the alignment
+        if (void* p = std::aligned_alloc(a, ((bytes ? bytes : 1) + a - 1) / a * a))
+            return p;
+        if (std::new_handler handler = std::get_new_handler())
+            handler();
+        else
+            throw std::bad_alloc();
+    }
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
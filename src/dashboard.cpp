@@ -0,0 +1,313 @@
+#include "dashboard.hpp"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <SFML/Graphics.hpp>
+
+// The render thread wakes up this often to drain events and draw
+#define DASHBOARD_FRAME_MS 33
+
+#define DASHBOARD_WIDTH 960
+#define DASHBOARD_HEIGHT 540
+#define DASHBOARD_IMAGE_SCALE 3
+
+void dashboard_state::apply(dashboard_event& event)
+{
+    switch (event.type)
+    {
+    case dashboard_event::kind::sample:
+    {
+        sample_t sample{ std::move(event.image), event.predicted, event.actual };
+        if (samples.size() < DASHBOARD_SAMPLES)
+            samples.push_back(std::move(sample));
+        else
+            samples[next_sample] = std::move(sample);
+        next_sample = (next_sample + 1) % DASHBOARD_SAMPLES;
+        break;
+    }
+    case dashboard_event::kind::metrics:
+        loss.emplace_back(event.step, event.loss);
+        if (event.accuracy >= 0.0f)
+            accuracy.emplace_back(event.step, event.accuracy);
+        break;
+    case dashboard_event::kind::weights:
+    {
+        auto it = std::find_if(histograms.begin(), histograms.end(),
+                               [&](const histogram_t& h) { return h.layer == event.layer; });
+        histogram_t hist{ event.layer, std::move(event.histogram), event.lo, event.hi };
+        if (it != histograms.end())
+            *it = std::move(hist);
+        else
+            histograms.push_back(std::move(hist));
+        break;
+    }
+    }
+}
+
+bool null_renderer::draw(const dashboard_state& state)
+{
+    (void)state;
+    frames.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+dashboard::dashboard(std::unique_ptr<dashboard_renderer> renderer_, size_t capacity)
+    : events(capacity), renderer(std::move(renderer_))
+{
+    worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+dashboard::~dashboard()
+{
+    worker.request_stop();
+}
+
+void dashboard::publish(dashboard_event&& event)
+{
+    if (!events.try_push(std::move(event)))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Each publisher checks for room first so a dropped event costs no copying
+void dashboard::publish_sample(uint64_t step, const vec<float>& image, size_t predicted, size_t actual)
+{
+    if (events.full())
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    dashboard_event event;
+    event.type = dashboard_event::kind::sample;
+    event.step = step;
+    event.image = image;
+    event.predicted = predicted;
+    event.actual = actual;
+    publish(std::move(event));
+}
+
+void dashboard::publish_metrics(uint64_t step, float loss, float accuracy)
+{
+    dashboard_event event;
+    event.type = dashboard_event::kind::metrics;
+    event.step = step;
+    event.loss = loss;
+    event.accuracy = accuracy;
+    publish(std::move(event));
+}
+
+void dashboard::publish_weights(uint64_t step, const NeuralNetwork& nn)
+{
+    const vec<basic_layer *>& layers = nn.get_layers();
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        // a first layer passes its input through and trains nothing
+        if (layers[l]->get_prev_size() == 0)
+            continue;
+
+        if (events.full())
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        vec<std::span<const float>> params = layers[l]->view_params();
+        if (params.empty())
+            continue;
+
+        dashboard_event event;
+        event.type = dashboard_event::kind::weights;
+        event.step = step;
+        event.layer = l;
+        event.lo = INFINITY;
+        event.hi = -INFINITY;
+        for (auto& p : params)
+        {
+            for (float w : p)
+            {
+                event.lo = std::min(event.lo, w);
+                event.hi = std::max(event.hi, w);
+            }
+        }
+
+        if (event.lo > event.hi)
+            continue;
+
+        event.histogram.assign(DASHBOARD_BINS, 0.0f);
+        const float scale = event.hi > event.lo ? DASHBOARD_BINS / (event.hi - event.lo) : 0.0f;
+        for (auto& p : params)
+        {
+            for (float w : p)
+                event.histogram[std::min<size_t>((w - event.lo) * scale, DASHBOARD_BINS - 1)] += 1.0f;
+        }
+
+        publish(std::move(event));
+    }
+}
+
+void dashboard::run(std::stop_token stop)
+{
+    dashboard_state state;
+    bool open = true;
+
+    while (!stop.stop_requested())
+    {
+        dashboard_event event;
+        while (events.try_pop(event))
+            state.apply(event);
+
+        // Keep draining after the window closed so publishers are never stuck
+        if (open)
+            open = renderer->draw(state);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(DASHBOARD_FRAME_MS));
+    }
+}
+
+// SFML renderer. The window is created lazily on the first draw() so it
+// belongs to the render thread.
+class sfml_renderer : public dashboard_renderer
+{
+    std::unique_ptr<sf::RenderWindow> window;
+    vec<sf::Texture> textures;
+    vec<uint8_t> pixels;
+
+    void draw_samples(const dashboard_state& state);
+    void draw_curve(const vec<std::pair<uint64_t, float>>& points, float x, float y, float w, float h,
+                    sf::Color color, bool unit_range);
+    void draw_histograms(const dashboard_state& state);
+
+public:
+    bool draw(const dashboard_state& state) override;
+};
+
+bool sfml_renderer::draw(const dashboard_state& state)
+{
+    if (!window)
+    {
+        window = std::make_unique<sf::RenderWindow>(sf::VideoMode(DASHBOARD_WIDTH, DASHBOARD_HEIGHT), "Training");
+        textures.resize(DASHBOARD_SAMPLES);
+    }
+
+    sf::Event event;
+    while (window->pollEvent(event))
+    {
+        if (event.type == sf::Event::Closed)
+            window->close();
+    }
+
+    if (!window->isOpen())
+        return false;
+
+    window->clear(sf::Color(24, 24, 24));
+    draw_samples(state);
+    draw_curve(state.loss, 400, 20, 540, 220, sf::Color::Red, false);
+    draw_curve(state.accuracy, 400, 260, 540, 120, sf::Color::Green, true);
+    draw_histograms(state);
+    window->display();
+
+    return true;
+}
+
+// Sample images in a 2 x 4 grid, framed green when predicted right and red otherwise
+void sfml_renderer::draw_samples(const dashboard_state& state)
+{
+    for (size_t i = 0; i < state.samples.size(); ++i)
+    {
+        const auto& sample = state.samples[i];
+        const uint side = std::sqrt(sample.image.size());
+        if (side == 0 || side * side != sample.image.size())
+            continue;
+
+        pixels.resize(side * side * 4);
+        for (size_t p = 0; p < side * side; ++p)
+        {
+            const uint8_t gray = static_cast<uint8_t>(std::round(std::clamp(sample.image[p], 0.0f, 1.0f) * 255.0f));
+            pixels[p * 4 + 0] = pixels[p * 4 + 1] = pixels[p * 4 + 2] = gray;
+            pixels[p * 4 + 3] = 255;
+        }
+
+        textures[i].create(side, side);
+        textures[i].update(pixels.data());
+
+        const float cell = side * DASHBOARD_IMAGE_SCALE + 12.0f;
+        const float x = 20 + (i % 4) * cell;
+        const float y = 20 + (i / 4) * cell;
+
+        sf::RectangleShape frame(sf::Vector2f(cell - 4, cell - 4));
+        frame.setPosition(x - 4, y - 4);
+        frame.setFillColor(sample.predicted == sample.actual ? sf::Color::Green : sf::Color::Red);
+        window->draw(frame);
+
+        sf::Sprite sprite(textures[i]);
+        sprite.setPosition(x, y);
+        sprite.setScale(DASHBOARD_IMAGE_SCALE, DASHBOARD_IMAGE_SCALE);
+        window->draw(sprite);
+    }
+}
+
+// Line plot of (step, value) in a w x h panel, scaled to [0, 1] or to the data range
+void sfml_renderer::draw_curve(const vec<std::pair<uint64_t, float>>& points, float x, float y, float w, float h,
+                               sf::Color color, bool unit_range)
+{
+    sf::RectangleShape panel(sf::Vector2f(w, h));
+    panel.setPosition(x, y);
+    panel.setFillColor(sf::Color(40, 40, 40));
+    window->draw(panel);
+
+    if (points.size() < 2)
+        return;
+
+    float lo = 0.0f, hi = 1.0f;
+    if (!unit_range)
+    {
+        lo = hi = points[0].second;
+        for (auto& [step, v] : points)
+        {
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+    }
+    const float range = hi > lo ? hi - lo : 1.0f;
+    const float first = points.front().first;
+    const float span = std::max<float>(points.back().first - first, 1.0f);
+
+    sf::VertexArray line(sf::LineStrip);
+    for (auto& [step, v] : points)
+        line.append(sf::Vertex(sf::Vector2f(x + (step - first) / span * w, y + h - (v - lo) / range * h), color));
+    window->draw(line);
+}
+
+// One bar chart per layer along the bottom
+void sfml_renderer::draw_histograms(const dashboard_state& state)
+{
+    const float w = 110.0f, h = 100.0f, y = DASHBOARD_HEIGHT - h - 20;
+    for (size_t i = 0; i < state.histograms.size(); ++i)
+    {
+        const auto& hist = state.histograms[i];
+        const float x = 20 + i * (w + 10);
+        if (x + w > DASHBOARD_WIDTH)
+            break;
+
+        sf::RectangleShape panel(sf::Vector2f(w, h));
+        panel.setPosition(x, y);
+        panel.setFillColor(sf::Color(40, 40, 40));
+        window->draw(panel);
+
+        const float peak = *std::max_element(hist.counts.begin(), hist.counts.end());
+        const float bar = w / hist.counts.size();
+        for (size_t b = 0; b < hist.counts.size(); ++b)
+        {
+            const float bh = peak > 0.0f ? hist.counts[b] / peak * h : 0.0f;
+            sf::RectangleShape rect(sf::Vector2f(bar - 1, bh));
+            rect.setPosition(x + b * bar, y + h - bh);
+            rect.setFillColor(sf::Color(100, 150, 255));
+            window->draw(rect);
+        }
+    }
+}
+
+std::unique_ptr<dashboard_renderer> make_sfml_renderer()
+{
+    return std::make_unique<sfml_renderer>();
+}
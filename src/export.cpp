@@ -0,0 +1,68 @@
+#include "export.hpp"
+#include <cmath>
+#include <cstdio>
+
+std::string float_literal(float f)
+{
+    // "%a" would print nan/inf, which are not C++ literals
+    if (std::isnan(f))
+        return "std::numeric_limits<float>::quiet_NaN()";
+    if (std::isinf(f))
+        return f < 0 ? "-std::numeric_limits<float>::infinity()" : "std::numeric_limits<float>::infinity()";
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%af", f);
+    return buf;
+}
+
+std::string export_writer::constant(const std::string& prefix, const float* data, size_t n)
+{
+    const std::string name = prefix + std::to_string(next_id++);
+
+    decls << "alignas(64) inline constexpr float " << name << "[" << n << "] = {";
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i % 8 == 0)
+            decls << "\n    ";
+        decls << float_literal(data[i]) << (i + 1 < n ? ", " : "");
+    }
+    decls << "\n};\n\n";
+
+    return name;
+}
+
+std::string export_writer::buffer(size_t n)
+{
+    const std::string name = "t" + std::to_string(next_id++);
+    body << "    alignas(64) float " << name << "[" << n << "];\n";
+    return name;
+}
+
+void export_writer::helper(const std::string& key, const std::string& code)
+{
+    if (helpers.insert(key).second)
+        decls << code << "\n";
+}
+
+std::string export_writer::str(const std::string& ns, size_t input_size, size_t output_size, const std::string& out) const
+{
+    std::ostringstream os;
+    os << "// Generated by NeuralNetwork::export_header, do not edit\n"
+       << "#pragma once\n\n"
+       << "#include <cmath>\n"
+       << "#include <limits>\n"
+       << "#include <cstddef>\n"
+       << "#include <algorithm>\n\n"
+       << "namespace " << ns << "\n{\n\n"
+       << "inline constexpr size_t input_size = " << input_size << ";\n"
+       << "inline constexpr size_t output_size = " << output_size << ";\n\n"
+       << decls.str()
+       << "// Run the network on input_size floats, writes output_size floats\n"
+       << "inline void infer(const float* in, float* result)\n{\n"
+       << body.str()
+       << "    std::copy(" << out << ", " << out << " + output_size, result);\n"
+       << "}\n\n"
+       << "} // namespace " << ns << "\n";
+
+    return os.str();
+}
@@ -0,0 +1,239 @@
+#include "inference_cache.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+typedef uint32_t hash_vec __attribute__((vector_size(HASH_LANES * sizeof(uint32_t))));
+
+uint64_t hash_input(std::span<const float> in)
+{
+    const size_t n = in.size();
+
+    // Every lane mixes its own column of the input, a multiply and shift per step
+    hash_vec h;
+    for (size_t l = 0; l < HASH_LANES; ++l)
+        h[l] = 0x9E3779B9u * (uint32_t)(l + 1);
+
+    size_t i = 0;
+    for (; i + HASH_LANES <= n; i += HASH_LANES)
+    {
+        hash_vec v;
+        __builtin_memcpy(&v, in.data() + i, sizeof(v));
+        h = (h ^ v) * 0x85EBCA6Bu;
+        h ^= h >> 15;
+    }
+
+    // Fold the lanes and the tail in order, so a permuted input hashes differently
+    uint64_t result = n;
+    for (size_t l = 0; l < HASH_LANES; ++l)
+        result = (result ^ h[l]) * 0x100000001B3ull;
+    for (; i < n; ++i)
+    {
+        uint32_t bits;
+        __builtin_memcpy(&bits, &in[i], sizeof(bits));
+        result = (result ^ bits) * 0x100000001B3ull;
+    }
+
+    result ^= result >> 33;
+    result *= 0xFF51AFD7ED558CCDull;
+    result ^= result >> 33;
+    return result;
+}
+
+static inline size_t entry_bytes(size_t in_size, size_t out_size)
+{
+    return (in_size + out_size) * sizeof(float) + INFERENCE_CACHE_ENTRY_OVERHEAD;
+}
+
+static inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inference_cache::inference_cache(NeuralNetwork& nn, const inference_cache_config_t& cfg_)
+    : nn(nn), cfg(cfg_)
+{
+    cfg.shards = std::max<size_t>(cfg.shards, 1);
+    shard_budget = cfg.budget_bytes / cfg.shards;
+    shards = std::make_unique<shard_t[]>(cfg.shards);
+}
+
+size_t inference_cache::find(shard_t& s, uint64_t hash, std::span<const float> in) const
+{
+    auto [first, last] = s.index.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        const entry& e = s.slots[it->second];
+        if (e.input.size() == in.size() && std::equal(e.input.begin(), e.input.end(), in.begin(),
+            [](float a, float b) { return __builtin_memcmp(&a, &b, sizeof(float)) == 0; }))
+            return it->second;
+    }
+
+    return SIZE_MAX;
+}
+
+void inference_cache::evict(shard_t& s, size_t slot)
+{
+    entry& e = s.slots[slot];
+
+    auto [first, last] = s.index.equal_range(e.hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second == slot)
+        {
+            s.index.erase(it);
+            break;
+        }
+    }
+
+    s.bytes -= entry_bytes(e.input.size(), e.output.size());
+    e = entry{};
+    s.free_slots.push_back(slot);
+}
+
+bool inference_cache::lookup(std::span<const float> in, vec<float>& out)
+{
+    return lookup(hash_input(in), in, out);
+}
+
+bool inference_cache::lookup(uint64_t hash, std::span<const float> in, vec<float>& out)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t version = nn.get_weights_version();
+
+    shard_t& s = shard_of(hash);
+    {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        const size_t slot = find(s, hash, in);
+        if (slot != SIZE_MAX)
+        {
+            entry& e = s.slots[slot];
+            if (e.version == version)
+            {
+                e.referenced = true;
+                out.assign(e.output.begin(), e.output.end());
+                ++s.hits;
+                s.hit_ns += elapsed_ns(start);
+                return true;
+            }
+
+            // Computed by older weights, drop it now rather than waiting for CLOCK
+            evict(s, slot);
+            ++s.stale;
+        }
+
+        ++s.misses;
+    }
+
+    return false;
+}
+
+void inference_cache::insert(uint64_t hash, uint64_t version, std::span<const float> in, std::span<const float> out)
+{
+    const size_t bytes = entry_bytes(in.size(), out.size());
+    if (bytes > shard_budget)
+        return;
+
+    shard_t& s = shard_of(hash);
+    std::lock_guard<std::mutex> lock(s.mtx);
+
+    // Another thread may have missed on the same input at the same time
+    const size_t existing = find(s, hash, in);
+    if (existing != SIZE_MAX)
+        evict(s, existing);
+
+    // CLOCK: sweep the hand, giving referenced entries a second chance
+    while (s.bytes + bytes > shard_budget)
+    {
+        entry& e = s.slots[s.hand];
+        if (e.used && e.referenced)
+            e.referenced = false;
+        else if (e.used)
+        {
+            evict(s, s.hand);
+            ++s.evictions;
+        }
+
+        s.hand = (s.hand + 1) % s.slots.size();
+    }
+
+    size_t slot;
+    if (s.free_slots.empty())
+    {
+        slot = s.slots.size();
+        s.slots.emplace_back();
+    }
+    else
+    {
+        slot = s.free_slots.back();
+        s.free_slots.pop_back();
+    }
+
+    entry& e = s.slots[slot];
+    e.hash = hash;
+    e.version = version;
+    e.input.assign(in.begin(), in.end());
+    e.output.assign(out.begin(), out.end());
+    e.referenced = false;
+    e.used = true;
+
+    s.index.emplace(hash, slot);
+    s.bytes += bytes;
+}
+
+vec<float> inference_cache::infer(std::span<const float> in)
+{
+    const uint64_t hash = hash_input(in);
+
+    vec<float> out;
+    if (lookup(hash, in, out))
+        return out;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(infer_mtx);
+        version = nn.get_weights_version();
+        std::span<const float> result = nn.infer(in);
+        out.assign(result.begin(), result.end());
+    }
+    miss_ns += elapsed_ns(start);
+
+    insert(hash, version, in, out);
+    return out;
+}
+
+void inference_cache::clear()
+{
+    for (size_t i = 0; i < cfg.shards; ++i)
+    {
+        shard_t& s = shards[i];
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.slots.clear();
+        s.free_slots.clear();
+        s.index.clear();
+        s.hand = 0;
+        s.bytes = 0;
+    }
+}
+
+inference_cache_stats inference_cache::get_stats() const
+{
+    inference_cache_stats stats;
+    stats.miss_seconds = miss_ns.load() * 1e-9;
+
+    for (size_t i = 0; i < cfg.shards; ++i)
+    {
+        shard_t& s = shards[i];
+        std::lock_guard<std::mutex> lock(s.mtx);
+        stats.hits += s.hits;
+        stats.misses += s.misses;
+        stats.stale += s.stale;
+        stats.evictions += s.evictions;
+        stats.hit_seconds += s.hit_ns * 1e-9;
+        stats.entries += s.index.size();
+        stats.bytes += s.bytes;
+    }
+
+    return stats;
+}
@@ -16,4 +16,38 @@ vec<float> activation_layer::backprop(const vec<float>& grads, dataset_config_t
 {
     (void)config;
     return activation->backward(grads);
-}
\ No newline at end of file
+}
+
+void activation_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+    activation->apply(in, out, in_size);
+}
+
+void activation_layer::train_into(const float* in, size_t in_size, float* out)
+{
+    activation->apply(in, out, in_size);
+}
+
+// Every derivative is written in terms of the output, the input is not needed
+void activation_layer::backprop_into(const float* in, size_t in_size, const float* out, float* grad_out,
+                                     float* grad_in, dataset_config_t config)
+{
+    (void)in;
+    (void)config;
+    if (grad_in)
+        activation->apply_backward(out, grad_out, grad_in, in_size);
+}
+
+void activation_layer::account_memory(layer_memory& m) const
+{
+    m.kind = "activation";
+    m.add(m.activations, activation->cached());
+}
+
+std::string activation_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+    // the network input is const, everything else can be overwritten in place
+    const std::string out = in == "in" ? w.buffer(in_size) : in;
+    activation->export_cpp(w, in, out, in_size);
+    return out;
+}
@@ -0,0 +1,269 @@
+#include "layers/conv2d_layer.hpp"
+#include <stdexcept>
+
+// GEMM tile sizes the autotuner can pick from, 0 is untiled
+static const size_t CONV2D_TILES[] = { 0, 32, 64, 128 };
+
+conv2d_layer::conv2d_layer(size_t in_channels, size_t in_height, size_t in_width,
+                           size_t out_channels, size_t kernel, size_t stride, size_t padding)
+    : basic_layer(0),
+      in_c(in_channels), in_h(in_height), in_w(in_width),
+      out_c(out_channels), kernel(kernel), stride(stride), padding(padding)
+{
+    if (stride == 0 || in_h + 2 * padding < kernel || in_w + 2 * padding < kernel)
+        throw std::runtime_error("conv2d_layer: kernel does not fit the input");
+
+    out_h = (in_h + 2 * padding - kernel) / stride + 1;
+    out_w = (in_w + 2 * padding - kernel) / stride + 1;
+    size = out_c * out_h * out_w;
+    variant = kernel <= CONV2D_DIRECT_MAX_KERNEL ? 0 : 1;
+}
+
+conv2d_layer::~conv2d_layer()
+{}
+
+void conv2d_layer::init(size_t prev_size)
+{
+    // prev_size is 0 when this is the first layer of the network
+    if (prev_size != 0 && prev_size != in_c * in_h * in_w)
+        throw std::runtime_error("conv2d_layer: expected " + std::to_string(in_c * in_h * in_w) +
+                                 " inputs, previous layer has " + std::to_string(prev_size));
+
+    this->prev_size = in_c * in_h * in_w;
+    if (weights.empty())
+    {
+        // Scale by fan-in so deep channel stacks don't saturate the activations
+        const size_t fan_in = in_c * kernel * kernel;
+        const double bound = 1.0 / std::sqrt((double)fan_in);
+        std::uniform_real_distribution<double> dist(-bound, bound);
+
+        weights = numa_buffer(out_c * fan_in);
+        biases.resize(out_c);
+        for (auto& w : weights)
+            w = dist(*gen);
+        for (auto& b : biases)
+            b = dist(*gen);
+    }
+}
+
+void conv2d_layer::get_params(vec<std::span<float>>& params)
+{
+    params.emplace_back(weights);
+    params.emplace_back(biases);
+}
+
+void conv2d_layer::account_memory(layer_memory& m) const
+{
+    m.kind = "conv2d";
+    m.add(m.parameters, weights);
+    m.add(m.parameters, biases);
+    m.add(m.activations, last_input);
+    m.add(m.activations, cols); // im2col of last_input, reused by backprop
+}
+
+std::string conv2d_layer::tuning_key() const
+{
+    return "conv2d " + std::to_string(in_c) + "x" + std::to_string(in_h) + "x" + std::to_string(in_w) +
+           " c" + std::to_string(out_c) + " k" + std::to_string(kernel) +
+           " s" + std::to_string(stride) + " p" + std::to_string(padding);
+}
+
+size_t conv2d_layer::num_variants() const
+{
+    return 1 + std::size(CONV2D_TILES);
+}
+
+void conv2d_layer::set_variant(size_t v)
+{
+    variant = std::min(v, num_variants() - 1);
+}
+
+// Unfold every receptive field of the input into a column of `cols`
+void conv2d_layer::im2col(const vec<float>& in)
+{
+    const size_t P = out_h * out_w;
+    if (cols.size() != in_c * kernel * kernel * P)
+        cols = numa_buffer(in_c * kernel * kernel * P);
+    else
+        std::fill(cols.begin(), cols.end(), 0.0f);
+
+    for (size_t c = 0; c < in_c; ++c)
+        for (size_t kh = 0; kh < kernel; ++kh)
+            for (size_t kw = 0; kw < kernel; ++kw)
+            {
+                float* row = cols.data() + ((c * kernel + kh) * kernel + kw) * P;
+                for (size_t oh = 0; oh < out_h; ++oh)
+                {
+                    const long ih = (long)(oh * stride + kh) - (long)padding;
+                    if (ih < 0 || ih >= (long)in_h)
+                        continue;
+
+                    for (size_t ow = 0; ow < out_w; ++ow)
+                    {
+                        const long iw = (long)(ow * stride + kw) - (long)padding;
+                        if (iw >= 0 && iw < (long)in_w)
+                            row[oh * out_w + ow] = in[(c * in_h + ih) * in_w + iw];
+                    }
+                }
+            }
+}
+
+// Inverse of im2col, overlapping receptive fields accumulate
+void conv2d_layer::col2im(const vec<float>& dcols, vec<float>& out) const
+{
+    const size_t P = out_h * out_w;
+    out.assign(in_c * in_h * in_w, 0.0f);
+
+    for (size_t c = 0; c < in_c; ++c)
+        for (size_t kh = 0; kh < kernel; ++kh)
+            for (size_t kw = 0; kw < kernel; ++kw)
+            {
+                const float* row = dcols.data() + ((c * kernel + kh) * kernel + kw) * P;
+                for (size_t oh = 0; oh < out_h; ++oh)
+                {
+                    const long ih = (long)(oh * stride + kh) - (long)padding;
+                    if (ih < 0 || ih >= (long)in_h)
+                        continue;
+
+                    for (size_t ow = 0; ow < out_w; ++ow)
+                    {
+                        const long iw = (long)(ow * stride + kw) - (long)padding;
+                        if (iw >= 0 && iw < (long)in_w)
+                            out[(c * in_h + ih) * in_w + iw] += row[oh * out_w + ow];
+                    }
+                }
+            }
+}
+
+vec<float> conv2d_layer::forward(const vec<float>& in)
+{
+    return use_direct() ? forward_direct(in) : forward_gemm(in);
+}
+
+vec<float> conv2d_layer::forward_direct(const vec<float>& in)
+{
+    last_input = in;
+
+    const size_t K = in_c * kernel * kernel;
+    vec<float> out(size);
+    for (size_t oc = 0; oc < out_c; ++oc)
+    {
+        const float* w = weights.data() + oc * K;
+        for (size_t oh = 0; oh < out_h; ++oh)
+            for (size_t ow = 0; ow < out_w; ++ow)
+            {
+                float sum = biases[oc];
+                for (size_t c = 0; c < in_c; ++c)
+                    for (size_t kh = 0; kh < kernel; ++kh)
+                    {
+                        const long ih = (long)(oh * stride + kh) - (long)padding;
+                        if (ih < 0 || ih >= (long)in_h)
+                            continue;
+
+                        for (size_t kw = 0; kw < kernel; ++kw)
+                        {
+                            const long iw = (long)(ow * stride + kw) - (long)padding;
+                            if (iw >= 0 && iw < (long)in_w)
+                                sum += w[(c * kernel + kh) * kernel + kw] * in[(c * in_h + ih) * in_w + iw];
+                        }
+                    }
+
+                out[(oc * out_h + oh) * out_w + ow] = sum;
+            }
+    }
+
+    return out;
+}
+
+vec<float> conv2d_layer::forward_gemm(const vec<float>& in)
+{
+    im2col(in);
+
+    const size_t P = out_h * out_w;
+    vec<float> out(size);
+    for (size_t oc = 0; oc < out_c; ++oc)
+        std::fill(out.begin() + oc * P, out.begin() + (oc + 1) * P, biases[oc]);
+
+    gemm_nn_tiled(out_c, P, in_c * kernel * kernel, weights.data(), cols.data(), out.data(), CONV2D_TILES[variant - 1]);
+    return out;
+}
+
+vec<float> conv2d_layer::backprop(const vec<float>& grads, dataset_config_t config)
+{
+    if (grads.size() != size)
+        return {};
+
+    vec<float> wgrads(weights.size(), 0.0f);
+    vec<float> bgrads(out_c, 0.0f);
+    vec<float> input_grads = use_direct() ? backprop_direct(grads, wgrads, bgrads)
+                                          : backprop_gemm(grads, wgrads, bgrads);
+
+    // apply gradient descent after the input gradients used the old weights
+    for (size_t i = 0; i < weights.size(); ++i)
+        weights[i] -= config.lr * wgrads[i];
+    for (size_t oc = 0; oc < out_c; ++oc)
+        biases[oc] -= config.lr * bgrads[oc];
+
+    return input_grads;
+}
+
+vec<float> conv2d_layer::backprop_direct(const vec<float>& grads, vec<float>& wgrads, vec<float>& bgrads)
+{
+    const size_t K = in_c * kernel * kernel;
+    vec<float> input_grads(in_c * in_h * in_w, 0.0f);
+
+    for (size_t oc = 0; oc < out_c; ++oc)
+    {
+        const float* w = weights.data() + oc * K;
+        float* dw = wgrads.data() + oc * K;
+
+        for (size_t oh = 0; oh < out_h; ++oh)
+            for (size_t ow = 0; ow < out_w; ++ow)
+            {
+                const float g = grads[(oc * out_h + oh) * out_w + ow];
+                bgrads[oc] += g;
+
+                for (size_t c = 0; c < in_c; ++c)
+                    for (size_t kh = 0; kh < kernel; ++kh)
+                    {
+                        const long ih = (long)(oh * stride + kh) - (long)padding;
+                        if (ih < 0 || ih >= (long)in_h)
+                            continue;
+
+                        for (size_t kw = 0; kw < kernel; ++kw)
+                        {
+                            const long iw = (long)(ow * stride + kw) - (long)padding;
+                            if (iw < 0 || iw >= (long)in_w)
+                                continue;
+
+                            const size_t wi = (c * kernel + kh) * kernel + kw;
+                            const size_t xi = (c * in_h + ih) * in_w + iw;
+                            dw[wi] += g * last_input[xi];
+                            input_grads[xi] += g * w[wi];
+                        }
+                    }
+            }
+    }
+
+    return input_grads;
+}
+
+vec<float> conv2d_layer::backprop_gemm(const vec<float>& grads, vec<float>& wgrads, vec<float>& bgrads)
+{
+    const size_t P = out_h * out_w;
+    const size_t K = in_c * kernel * kernel;
+
+    for (size_t oc = 0; oc < out_c; ++oc)
+        for (size_t p = 0; p < P; ++p)
+            bgrads[oc] += grads[oc * P + p];
+
+    // dW = dY * cols^T, dcols = W^T * dY
+    gemm_nt(out_c, K, P, grads.data(), cols.data(), wgrads.data());
+
+    vec<float> dcols(K * P, 0.0f);
+    gemm_tn(K, P, out_c, weights.data(), grads.data(), dcols.data());
+
+    vec<float> input_grads;
+    col2im(dcols, input_grads);
+    return input_grads;
+}
@@ -11,6 +11,8 @@ dense_layer::~dense_layer()
 
 void dense_layer::init(size_t prev_size)
 {
+    this->prev_size = prev_size;
+
     // propagate RNG to children (basic_layer::set_gen is non-virtual and was
     // already called on this object by the network, so forward the stored
     // generator to inner layers before they initialize their parameters)
@@ -21,6 +23,73 @@ void dense_layer::init(size_t prev_size)
     act->init(size);
 }
 
+void dense_layer::get_params(vec<std::span<float>>& params)
+{
+    linear->get_params(params);
+}
+
+void dense_layer::set_input_grads(bool needed)
+{
+    linear->set_input_grads(needed);
+}
+
+bool dense_layer::has_params() const
+{
+    return linear->has_params();
+}
+
+void dense_layer::begin_updates()
+{
+    linear->begin_updates();
+}
+
+void dense_layer::end_updates()
+{
+    linear->end_updates();
+}
+
+void dense_layer::prune(float sparsity, bool structured)
+{
+    linear->prune(sparsity, structured);
+}
+
+void dense_layer::compress()
+{
+    linear->compress();
+}
+
+void dense_layer::replicate()
+{
+    linear->replicate();
+}
+
+void dense_layer::account_memory(layer_memory& m) const
+{
+    linear->account_memory(m);
+    act->account_memory(m);
+    m.kind = "dense";
+}
+
+std::string dense_layer::tuning_key() const
+{
+    return linear->tuning_key();
+}
+
+size_t dense_layer::num_variants() const
+{
+    return linear->num_variants();
+}
+
+size_t dense_layer::get_variant() const
+{
+    return linear->get_variant();
+}
+
+void dense_layer::set_variant(size_t v)
+{
+    linear->set_variant(v);
+}
+
 vec<float> dense_layer::forward(const vec<float>& in)
 {
     return act->forward(linear->forward(in));
@@ -30,3 +99,36 @@ vec<float> dense_layer::backprop(const vec<float>& grad, dataset_config_t config
 {
     return linear->backprop(act->backprop(grad, config), config);
 }
+
+void dense_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+    linear->forward_into(in, in_size, out);
+    act->forward_into(out, size, out);
+}
+
+void dense_layer::forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size)
+{
+    linear->forward_batch_into(in, in_size, n, out, out_size);
+    for (size_t i = 0; i < n; ++i)
+        act->forward_into(out + i * out_size, size, out + i * out_size);
+}
+
+void dense_layer::train_into(const float* in, size_t in_size, float* out)
+{
+    linear->train_into(in, in_size, out);
+    act->train_into(out, size, out);
+}
+
+// The activation only reads its output, so the pre-activations are not kept
+// and its gradient replaces grad_out
+void dense_layer::backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                                dataset_config_t config)
+{
+    act->backprop_into(out, size, out, grad_out, grad_out, config);
+    linear->backprop_into(in, in_size, out, grad_out, grad_in, config);
+}
+
+std::string dense_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+    return act->export_cpp(w, linear->export_cpp(w, in, in_size), size);
+}
@@ -1,5 +1,6 @@
 #include "layers/gating_layer.hpp"
 #include <algorithm>
+#include "export.hpp"
 
 gating_layer::gating_layer(size_t size) : basic_layer(size)
 {
@@ -23,37 +24,87 @@ void gating_layer::init(size_t prev_size)
     }
 }
 
-vec<float> gating_layer::forward(const vec<float>& in)
+void gating_layer::get_params(vec<std::span<float>>& params)
 {
-    last_input = in;
-    vec<float> out(size, 0.0f);
+    params.emplace_back(alpha);
+}
 
-    for (size_t i = 0; i < size; ++i)
-    {
-        float x = in[i];
+void gating_layer::account_memory(layer_memory& m) const
+{
+    m.kind = "gating";
+    m.add(m.parameters, alpha);
+    m.add(m.gradients, galpha);
+    m.add(m.activations, last_input);
+}
 
-        // 1️⃣ Clip x to avoid log(0), sqrt(negatives), and exp overflow
-        x = std::clamp(x, -20.0f, 20.0f);
+// Gated output of a single input with gating parameter a
+static inline float gate(float x, float a)
+{
 
-        // 2️⃣ Ensure positive for sqrt/log
-        float safe_x = std::max(std::fabs(x), 1e-6f);
+    // 1️⃣ Clip x to avoid log(0), sqrt(negatives), and exp overflow
+    x = std::clamp(x, -20.0f, 20.0f);
 
-        // 3️⃣ Compute the inner safely
-        float exp_neg_x = std::exp(-x);
-        float inner = std::sqrt(safe_x) / (1.0f + exp_neg_x);
+    // 2️⃣ Ensure positive for sqrt/log
+    float safe_x = std::max(std::fabs(x), 1e-6f);
 
-        // 4️⃣ Avoid log(0)
-        inner = std::max(inner, 1e-6f);
+    // 3️⃣ Compute the inner safely
+    float exp_neg_x = std::exp(-x);
+    float inner = std::sqrt(safe_x) / (1.0f + exp_neg_x);
 
-        // 5️⃣ Compute gating
-        float gated = x * std::exp(alpha[i] * std::log(inner));
+    // 4️⃣ Avoid log(0)
+    inner = std::max(inner, 1e-6f);
 
-        // 6️⃣ Avoid inf/nan
-        if (!std::isfinite(gated))
-            gated = 0.0f;
+    // 5️⃣ Compute gating
+    float gated = x * std::exp(a * std::log(inner));
 
-        out[i] = gated;
-    }
+    // 6️⃣ Avoid inf/nan
+    if (!std::isfinite(gated))
+        gated = 0.0f;
+
+    return gated;
+}
+
+vec<float> gating_layer::forward(const vec<float>& in)
+{
+    last_input = in;
+    vec<float> out(size, 0.0f);
+
+    for (size_t i = 0; i < size; ++i)
+        out[i] = gate(in[i], alpha[i]);
+
+    return out;
+}
+
+void gating_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+    (void)in_size;
+    for (size_t i = 0; i < size; ++i)
+        out[i] = gate(in[i], alpha[i]);
+}
+
+std::string gating_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+    (void)in_size;
+    w.helper("gate",
+        "// Gated output of a single input with gating parameter a, see gating_layer\n"
+        "inline float gate(float x, float a)\n"
+        "{\n"
+        "    x = std::clamp(x, -20.0f, 20.0f);\n"
+        "    float safe_x = std::max(std::fabs(x), 1e-6f);\n"
+        "    float exp_neg_x = std::exp(-x);\n"
+        "    float inner = std::sqrt(safe_x) / (1.0f + exp_neg_x);\n"
+        "    inner = std::max(inner, 1e-6f);\n"
+        "    float gated = x * std::exp(a * std::log(inner));\n"
+        "    if (!std::isfinite(gated))\n"
+        "        gated = 0.0f;\n"
+        "    return gated;\n"
+        "}\n");
+
+    const std::string A = w.constant("alpha", alpha.data(), alpha.size());
+    const std::string out = in == "in" ? w.buffer(size) : in;
+
+    w.code() << "    for (size_t i = 0; i < " << size << "; ++i)\n"
+             << "        " << out << "[i] = gate(" << in << "[i], " << A << "[i]);\n";
 
     return out;
 }
@@ -1,4 +1,7 @@
 #include "layers/basic_layer.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
 
 basic_layer::~basic_layer() = default;
 
@@ -6,3 +9,94 @@ void basic_layer::init(size_t prev_size)
 {
 	this->prev_size = prev_size;
 }
+
+void basic_layer::get_params(vec<std::span<float>>& params)
+{
+	(void)params;
+}
+
+void basic_layer::get_buffers(vec<std::span<float>>& buffers)
+{
+	(void)buffers;
+}
+
+void basic_layer::set_input_grads(bool needed)
+{
+	(void)needed;
+}
+
+void basic_layer::begin_updates()
+{}
+
+void basic_layer::end_updates()
+{}
+
+// Fallback for layers without a buffer-based forward
+void basic_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+	vec<float> out_vec = forward(vec<float>(in, in + in_size));
+	std::copy(out_vec.begin(), out_vec.end(), out);
+}
+
+void basic_layer::forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size)
+{
+	for (size_t i = 0; i < n; ++i)
+		forward_into(in + i * in_size, in_size, out + i * out_size);
+}
+
+void basic_layer::train_into(const float* in, size_t in_size, float* out)
+{
+	vec<float> out_vec = forward(vec<float>(in, in + in_size));
+	std::copy(out_vec.begin(), out_vec.end(), out);
+}
+
+void basic_layer::backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                                dataset_config_t config)
+{
+	(void)in;
+	(void)out;
+	vec<float> grads = backprop(vec<float>(grad_out, grad_out + size), config);
+	if (!grad_in)
+		return;
+
+	if (grads.size() == in_size)
+		std::copy(grads.begin(), grads.end(), grad_in);
+	else
+		std::fill(grad_in, grad_in + in_size, 0.0f);
+}
+
+std::string basic_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+	(void)w;
+	(void)in;
+	(void)in_size;
+	throw std::runtime_error(std::string("Layer cannot be exported: ") + typeid(*this).name());
+}
+
+void basic_layer::prune(float sparsity, bool structured)
+{
+	(void)sparsity;
+	(void)structured;
+}
+
+void basic_layer::compress()
+{}
+
+void basic_layer::replicate()
+{}
+
+std::string basic_layer::tuning_key() const
+{
+	return "";
+}
+
+void basic_layer::set_variant(size_t variant)
+{
+	(void)variant;
+}
+
+void basic_layer::account_memory(layer_memory& m) const
+{
+	m.kind = "layer";
+	m.add(m.activations, last_input);
+}
@@ -1,11 +1,30 @@
 #include "layers/linear_layer.hpp"
+#include "export.hpp"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <unordered_map>
 
-linear_layer::linear_layer(size_t size) : basic_layer(size)
+// Sparse-path density thresholds the autotuner can pick from: never, low, the
+// default LINEAR_SPARSE_MAX_DENSITY, and always
+static const float LINEAR_SPARSE_THRESHOLDS[] = { 0.0f, 0.3f, LINEAR_SPARSE_MAX_DENSITY, 1.0f };
+#define LINEAR_DEFAULT_VARIANT 2
+
+struct linear_layer::sparse_input
+{
+    bool sparse = false;
+    float base = 0.0f;  // value of every input not in idx
+    float sum = 0.0f;   // of all inputs, while centred
+    vec<uint32_t> idx;  // inputs that differ from base
+    vec<float> val;     // and by how much
+    size_t skip = 0;    // samples left before the next scan
+    size_t misses = 0;  // scans in a row that found the input too dense
+};
+
+linear_layer::linear_layer(size_t size) : basic_layer(size), variant(LINEAR_DEFAULT_VARIANT)
 {
     // delay initialization until we know the input size (from forward)
-    weights.clear();
     biases.clear();
-    weight_grads.clear();
     bias_grads.clear();
 }
 
@@ -20,17 +39,37 @@ void linear_layer::init(size_t prev_size)
     {
         std::uniform_real_distribution<double> dist(-1.0, 1.0);
 
-        weights.resize(size);
+        weights = numa_matrix(size, prev_size); // Each neuron connects to all neurons in previous layer
         biases.resize(size);
 
         for (uint i = 0; i < size; ++i)
         {
-            weights[i].resize(prev_size); // Each neuron connects to all neurons in previous layer
             for (uint j = 0; j < prev_size; ++j)
                 weights[i][j] = dist(*gen);
             biases[i] = dist(*gen);
         }
     }
+
+    if (prev_size != 0)
+    {
+        bias_grads.assign(size, 0.0f);
+        row_offsets.assign(size, 0.0f);
+        row_sums.assign(size, 0.0f);
+    }
+}
+
+void linear_layer::get_params(vec<std::span<float>>& params)
+{
+    params.emplace_back(weights.flat());
+    params.emplace_back(biases);
+}
+
+// Hogwild threads share the layer, so what forward() finds in a sample is
+// kept per thread for the backprop() of the same sample
+linear_layer::sparse_input& linear_layer::thread_input() const
+{
+    thread_local std::unordered_map<const linear_layer*, sparse_input> inputs;
+    return inputs[this];
 }
 
 vec<float> linear_layer::forward(const vec<float>& in)
@@ -42,48 +81,395 @@ vec<float> linear_layer::forward(const vec<float>& in)
     last_input = in;
 
     vec<float> out(size, 0.00f);
+    train_into(in.data(), in.size(), out.data());
+    return out;
+}
+
+void linear_layer::train_into(const float* in_ptr, size_t in_size, float* out)
+{
+    const std::span<const float> in(in_ptr, in_size);
+    if (prev_size == 0)
+    {
+        std::copy(in.begin(), in.end(), out);
+        return;
+    }
+
+    // Only inputs that differ from a base shared by most of them are
+    // multiplied, the base adds base * the row's weight sum. The first and
+    // last inputs are cheap guesses at it (corner pixels of an image are
+    // background), then zero, as behind a ReLU. Layers with dense inputs only
+    // pay for the scan once every LINEAR_SPARSE_RECHECK samples.
+    sparse_input& s = thread_input();
+    const float max_density = LINEAR_SPARSE_THRESHOLDS[variant];
+    s.sparse = false;
+    if (max_density > 0.0f && s.skip == 0)
+    {
+        const size_t max_count = in.size() * max_density;
+        const float guesses[] = { centred ? in.front() : 0.0f, centred ? in.back() : 0.0f, 0.0f };
+        for (size_t g = 0; g < std::size(guesses) && !s.sparse; ++g)
+        {
+            if (g > 0 && guesses[g] == guesses[g - 1])
+                continue;
+            s.base = guesses[g];
+            s.sparse = split_sparse(in, s.base, max_count, s.idx, s.val);
+        }
+
+        if (s.sparse)
+            s.misses = 0;
+        else
+            s.skip = std::min<size_t>(LINEAR_SPARSE_RECHECK, size_t(1) << std::min<size_t>(s.misses++, 16));
+    }
+    else if (s.skip > 0)
+        --s.skip;
+
+    // the row offsets apply to every input
+    s.sum = 0.0f;
+    if (centred)
+    {
+        s.sum = s.sparse ? s.base * in.size() + std::accumulate(s.val.begin(), s.val.end(), 0.0f)
+                         : std::accumulate(in.begin(), in.end(), 0.0f);
+    }
+
     for (size_t i = 0; i < size; ++i)
-        out[i] = mult_add(in, weights[i], biases[i]);
-    
+    {
+        float bias = biases[i];
+        if (centred)
+            bias += row_offsets[i] * s.sum + (s.sparse ? s.base * row_sums[i] : 0.0f);
+
+        out[i] = s.sparse ? sparse_mult_add(s.idx, s.val, weights[i], bias) : mult_add(in, weights[i], bias);
+    }
+}
+
+void linear_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+    if (prev_size == 0)
+    {
+        std::copy(in, in + in_size, out);
+        return;
+    }
+
+    if (compressed)
+    {
+        // the kernel reads whole blocks, so give it a zero-padded input
+        std::copy(in, in + prev_size, padded_input.begin());
+        bcsr_gemv(*compressed, padded_input.data(), biases.data(), out);
+        return;
+    }
+
+    // the copy on this thread's node, if replicate() made them
+    const numa_matrix& local = replicas.empty() ? weights : replicas[current_numa_node() % replicas.size()];
+    for (size_t i = 0; i < size; ++i)
+    {
+        const float* w = local[i].data();
+        float sum = 0.00f;
+        for (size_t j = 0; j < prev_size; ++j)
+            sum += in[j] * w[j];
+        out[i] = sum + biases[i];
+    }
+}
+
+// Only the block-sparse kernel gains from seeing the batch: it loads every
+// stored block once and multiplies it into all inputs
+void linear_layer::forward_batch_into(const float* in, size_t in_size, size_t n, float* out, size_t out_size)
+{
+    if (prev_size == 0 || !compressed)
+    {
+        basic_layer::forward_batch_into(in, in_size, n, out, out_size);
+        return;
+    }
+
+    const size_t ld = (prev_size + BCSR_BLOCK - 1) / BCSR_BLOCK * BCSR_BLOCK;
+    if (padded_input.size() < n * ld)
+        padded_input.resize(n * ld, 0.0f);
+    for (size_t i = 0; i < n; ++i)
+        std::copy(in + i * in_size, in + i * in_size + prev_size, padded_input.begin() + i * ld);
+
+    bcsr_gemm(*compressed, padded_input.data(), n, ld, biases.data(), out);
+}
+
+void linear_layer::account_memory(layer_memory& m) const
+{
+    m.kind = "linear";
+    m.add(m.parameters, weights);
+    m.add(m.parameters, biases);
+    m.add(m.gradients, bias_grads);
+    m.add(m.activations, last_input);
+
+    // plain SGD keeps no moments, the pruning mask is the only per-weight state
+    m.add(m.optimizer, mask);
+
+    if (compressed)
+    {
+        m.add(m.workspace, compressed->row_ptr);
+        m.add(m.workspace, compressed->block_col);
+        m.add(m.workspace, compressed->values);
+        m.overhead += sizeof(bcsr_matrix);
+    }
+    m.add(m.workspace, row_offsets);
+    m.add(m.workspace, row_sums);
+    m.add(m.workspace, padded_input);
+    for (const numa_matrix& r : replicas)
+        m.add(m.workspace, r);
+}
+
+std::string linear_layer::tuning_key() const
+{
+    return "linear " + std::to_string(prev_size) + "x" + std::to_string(size);
+}
+
+size_t linear_layer::num_variants() const
+{
+    // the identity first layer has nothing to choose
+    return prev_size == 0 ? 1 : std::size(LINEAR_SPARSE_THRESHOLDS);
+}
+
+void linear_layer::set_variant(size_t v)
+{
+    variant = std::min(v, std::size(LINEAR_SPARSE_THRESHOLDS) - 1);
+}
+
+void linear_layer::prune(float sparsity, bool structured)
+{
+    if (prev_size == 0 || weights.empty())
+        return;
+
+    sparsity = std::clamp(sparsity, 0.0f, 1.0f);
+    mask.assign(size, vec<uint8_t>(prev_size, 1));
+    compressed.reset();
+    replicas.clear();
+
+    // Score every weight (or every BCSR block of weights) by magnitude
+    const size_t group = structured ? BCSR_BLOCK : 1;
+    const size_t groups_per_row = (prev_size + group - 1) / group;
+    vec<float> score(size * groups_per_row, 0.0f);
+    for (size_t o = 0; o < size; ++o)
+    {
+        for (size_t i = 0; i < prev_size; ++i)
+            score[o * groups_per_row + i / group] += weights[o][i] * weights[o][i];
+    }
+
+    const size_t num_pruned = (size_t)(sparsity * score.size());
+    if (num_pruned == 0)
+        return;
+
+    vec<float> sorted = score;
+    std::nth_element(sorted.begin(), sorted.begin() + (num_pruned - 1), sorted.end());
+    const float threshold = sorted[num_pruned - 1];
+
+    // Ties at the threshold are pruned in order until the target is reached
+    size_t pruned = 0;
+    for (size_t o = 0; o < size; ++o)
+    {
+        for (size_t g = 0; g < groups_per_row; ++g)
+        {
+            const float s = score[o * groups_per_row + g];
+            if (s > threshold || (s == threshold && pruned >= num_pruned))
+                continue;
+            ++pruned;
+
+            for (size_t i = g * group; i < std::min((g + 1) * group, prev_size); ++i)
+            {
+                mask[o][i] = 0;
+                weights[o][i] = 0.0f;
+            }
+        }
+    }
+}
+
+void linear_layer::replicate()
+{
+    replicas.clear();
+    const size_t nodes = numa_nodes().size();
+    if (prev_size == 0 || weights.empty() || nodes < 2)
+        return;
+
+    // Bound before the copy touches the pages, so each replica is node-local
+    for (size_t n = 0; n < nodes; ++n)
+    {
+        replicas.emplace_back(size, prev_size, (int)n);
+        std::copy(weights.data(), weights.data() + size * prev_size, replicas.back().data());
+    }
+}
+
+void linear_layer::compress()
+{
+    if (prev_size == 0 || weights.empty())
+        return;
+
+    compressed = std::make_unique<bcsr_matrix>(to_bcsr(weights));
+    padded_input.assign((prev_size + BCSR_BLOCK - 1) / BCSR_BLOCK * BCSR_BLOCK, 0.0f);
+}
+
+std::string linear_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+    if (prev_size == 0)
+        return in;
+
+    (void)in_size;
+    const std::string W = w.constant("w", weights.data(), size * prev_size);
+    const std::string B = w.constant("b", biases.data(), biases.size());
+    const std::string out = w.buffer(size);
+
+    w.code() << "    for (size_t i = 0; i < " << size << "; ++i)\n"
+             << "    {\n"
+             << "        float sum = 0.00f;\n"
+             << "        for (size_t j = 0; j < " << prev_size << "; ++j)\n"
+             << "            sum += " << in << "[j] * " << W << "[i * " << prev_size << " + j];\n"
+             << "        " << out << "[i] = sum + " << B << "[i];\n"
+             << "    }\n";
+
     return out;
 }
 
+void linear_layer::begin_updates()
+{
+    // pruned weights have to stay zero, which a row offset would break
+    centred = prev_size != 0 && mask.empty();
+    if (!centred)
+        return;
+
+    for (size_t o = 0; o < size; ++o)
+    {
+        std::span<const float> row = weights[o];
+        row_sums[o] = std::accumulate(row.begin(), row.end(), 0.0f);
+    }
+}
+
+void linear_layer::end_updates()
+{
+    // the weights changed, so the inference copies are stale
+    compressed.reset();
+    replicas.clear();
+
+    if (!centred)
+        return;
+    centred = false;
+
+    for (size_t o = 0; o < size; ++o)
+    {
+        if (row_offsets[o] == 0.0f)
+            continue;
+
+        for (float& w : weights[o])
+            w += row_offsets[o];
+        row_offsets[o] = 0.0f;
+    }
+}
+
+numa_matrix linear_layer::get_weight_grads() const
+{
+    if (bias_grads.size() != size || last_input.size() != prev_size)
+        return {};
+
+    numa_matrix grads(size, prev_size);
+    for (size_t o = 0; o < size; ++o)
+    {
+        for (size_t i = 0; i < prev_size; ++i)
+            grads[o][i] = bias_grads[o] * last_input[i];
+    }
+
+    return grads;
+}
+
 vec<float> linear_layer::backprop(const vec<float>& grads, dataset_config_t config)
 {
-    if (prev_size == 0 || grads.size() != size)
+    if (prev_size == 0 || grads.size() != size || last_input.size() != prev_size)
         return {};
 
-    const size_t in_sz = last_input.size();
-    vec<float> input_grads(in_sz, 0.0f);
+    vec<float> input_grads(need_input_grads ? prev_size : 0, 0.0f);
+    vec<float> grad_out = grads;
+    backprop_into(last_input.data(), prev_size, nullptr, grad_out.data(), need_input_grads ? input_grads.data() : nullptr,
+                  config);
+    return input_grads;
+}
 
-    if (weight_grads.size() != size || (in_sz > 0 && weight_grads[0].size() != in_sz))
-        weight_grads.assign(size, vec<float>(in_sz, 0.0f));
-    bias_grads.assign(size, 0.0f);
+void linear_layer::backprop_into(const float* in, size_t in_size, const float* out, float* grad_out, float* grad_in,
+                                 dataset_config_t config)
+{
+    (void)out;
+    if (prev_size == 0)
+    {
+        if (grad_in)
+            std::copy(grad_out, grad_out + in_size, grad_in);
+        return;
+    }
+
+    const float* grads = grad_out;
+    const sparse_input& s = thread_input();
+    if (s.sparse)
+    {
+        backprop_sparse(grads, grad_in, config, s);
+        return;
+    }
+
+    if (grad_in)
+        std::fill(grad_in, grad_in + prev_size, 0.0f);
 
     for (size_t out_i = 0; out_i < size; ++out_i)
     {
         // bias gradient is simply the output gradient
         bias_grads[out_i] = grads[out_i];
+        const float offset = row_offsets[out_i];
 
-        for (size_t in_i = 0; in_i < in_sz; ++in_i)
+        for (size_t in_i = 0; in_i < prev_size; ++in_i)
         {
             // compute gradient for this weight (outer product)
-            const float wgrad = grads[out_i] * last_input[in_i];
-            weight_grads[out_i][in_i] = wgrad;
+            const float wgrad = grads[out_i] * in[in_i];
 
             // accumulate gradient w.r.t. input using the original weight
-            if (!weights.empty())
-                input_grads[in_i] += weights[out_i][in_i] * grads[out_i];
+            if (grad_in)
+                grad_in[in_i] += (weights[out_i][in_i] + offset) * grads[out_i];
 
             // apply gradient descent update to the weight (after using old weight)
-            if (!weights.empty())
-                weights[out_i][in_i] -= config.lr * wgrad;
+            weights[out_i][in_i] -= config.lr * wgrad;
+            if (!mask.empty())
+                weights[out_i][in_i] *= mask[out_i][in_i];
         }
 
         // apply gradient descent update to the bias
-        if (!biases.empty())
-            biases[out_i] -= config.lr * bias_grads[out_i];
+        biases[out_i] -= config.lr * bias_grads[out_i];
+
+        // other threads update the same sums
+        if (centred)
+            std::atomic_ref<float>(row_sums[out_i]).fetch_sub(config.lr * grads[out_i] * s.sum);
     }
+}
 
-    return input_grads;
+// The input is base plus the sparse (idx, val), so each row's weight gradient
+// is g * base on every column plus g * val on the columns in idx. The first
+// part goes into the row offset, only the columns in idx are touched. Input
+// gradients still need every column.
+void linear_layer::backprop_sparse(const float* grads, float* grad_in, dataset_config_t config, const sparse_input& s)
+{
+    if (grad_in)
+        std::fill(grad_in, grad_in + prev_size, 0.0f);
+    const float val_sum = std::accumulate(s.val.begin(), s.val.end(), 0.0f);
+
+    for (size_t out_i = 0; out_i < size; ++out_i)
+    {
+        const float g = grads[out_i];
+        bias_grads[out_i] = g;
+
+        if (grad_in)
+        {
+            const float offset = row_offsets[out_i];
+            for (size_t in_i = 0; in_i < prev_size; ++in_i)
+                grad_in[in_i] += (weights[out_i][in_i] + offset) * g;
+        }
+
+        for (size_t k = 0; k < s.idx.size(); ++k)
+        {
+            const uint32_t in_i = s.idx[k];
+            weights[out_i][in_i] -= config.lr * g * s.val[k];
+            if (!mask.empty())
+                weights[out_i][in_i] *= mask[out_i][in_i];
+        }
+
+        biases[out_i] -= config.lr * g;
+        if (centred)
+        {
+            row_offsets[out_i] -= config.lr * g * s.base;
+            std::atomic_ref<float>(row_sums[out_i]).fetch_sub(config.lr * g * val_sum);
+        }
+    }
 }
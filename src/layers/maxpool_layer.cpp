@@ -0,0 +1,77 @@
+#include "layers/maxpool_layer.hpp"
+#include <stdexcept>
+#include <limits>
+
+maxpool_layer::maxpool_layer(size_t channels, size_t in_height, size_t in_width, size_t pool, size_t stride)
+    : basic_layer(0), channels(channels), in_h(in_height), in_w(in_width),
+      pool(pool), stride(stride ? stride : pool)
+{
+    if (pool == 0 || in_h < pool || in_w < pool)
+        throw std::runtime_error("maxpool_layer: pool does not fit the input");
+
+    out_h = (in_h - pool) / this->stride + 1;
+    out_w = (in_w - pool) / this->stride + 1;
+    size = channels * out_h * out_w;
+}
+
+maxpool_layer::~maxpool_layer()
+{}
+
+void maxpool_layer::init(size_t prev_size)
+{
+    if (prev_size != 0 && prev_size != channels * in_h * in_w)
+        throw std::runtime_error("maxpool_layer: expected " + std::to_string(channels * in_h * in_w) +
+                                 " inputs, previous layer has " + std::to_string(prev_size));
+
+    this->prev_size = channels * in_h * in_w;
+}
+
+void maxpool_layer::account_memory(layer_memory& m) const
+{
+    m.kind = "maxpool";
+    m.add(m.activations, argmax_idx);
+}
+
+vec<float> maxpool_layer::forward(const vec<float>& in)
+{
+    vec<float> out(size);
+    argmax_idx.resize(size);
+
+    for (size_t c = 0; c < channels; ++c)
+        for (size_t oh = 0; oh < out_h; ++oh)
+            for (size_t ow = 0; ow < out_w; ++ow)
+            {
+                float best = -std::numeric_limits<float>::infinity();
+                size_t best_idx = 0;
+                for (size_t ph = 0; ph < pool; ++ph)
+                    for (size_t pw = 0; pw < pool; ++pw)
+                    {
+                        const size_t idx = (c * in_h + oh * stride + ph) * in_w + ow * stride + pw;
+                        if (in[idx] > best)
+                        {
+                            best = in[idx];
+                            best_idx = idx;
+                        }
+                    }
+
+                const size_t o = (c * out_h + oh) * out_w + ow;
+                out[o] = best;
+                argmax_idx[o] = best_idx;
+            }
+
+    return out;
+}
+
+vec<float> maxpool_layer::backprop(const vec<float>& grads, dataset_config_t config)
+{
+    (void)config;
+    if (argmax_idx.size() != size || grads.size() != size)
+        return {};
+
+    // Only the winning input of each window receives gradient
+    vec<float> input_grads(prev_size, 0.0f);
+    for (size_t o = 0; o < size; ++o)
+        input_grads[argmax_idx[o]] += grads[o];
+
+    return input_grads;
+}
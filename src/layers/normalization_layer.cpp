@@ -1,7 +1,70 @@
 #include "layers/normalization_layer.hpp"
+#include "export.hpp"
+#include <stdexcept>
 
-normalization_layer::normalization_layer(size_t size) : basic_layer(size)
+#define NORM_EPS 1e-5f
+
+// Vector width of the Welford reduction
+#define NORM_LANES 8
+
+typedef float norm_vec __attribute__((vector_size(NORM_LANES * sizeof(float))));
+
+// Standardize n values in one read pass for the statistics and one for the
+// output, returns the inverse standard deviation. Each vector lane runs
+// Welford's update over its own stride, then the lanes and the tail are
+// merged with Chan's formula, which stays accurate where sum / sum of
+// squares would cancel.
+static float layer_normalize(const float* in, size_t n, float* norm)
+{
+    // No statistics of an empty input, and nothing to write
+    if (n == 0)
+        return 0.0f;
+
+    const size_t blocks = n / NORM_LANES;
+    norm_vec lane_mean = {};
+    norm_vec lane_m2 = {};
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        norm_vec v;
+        __builtin_memcpy(&v, in + b * NORM_LANES, sizeof(v));
+
+        const norm_vec delta = v - lane_mean;
+        lane_mean += delta * (1.0f / (b + 1));
+        lane_m2 += delta * (v - lane_mean);
+    }
+
+    float count = 0.0f, mean = 0.0f, m2 = 0.0f;
+    auto merge = [&](float n_b, float mean_b, float m2_b)
+    {
+        const float total = count + n_b;
+        const float delta = mean_b - mean;
+        mean += delta * n_b / total;
+        m2 += m2_b + delta * delta * count * n_b / total;
+        count = total;
+    };
+
+    if (blocks)
+    {
+        for (size_t l = 0; l < NORM_LANES; ++l)
+            merge(blocks, lane_mean[l], lane_m2[l]);
+    }
+    for (size_t i = blocks * NORM_LANES; i < n; ++i)
+        merge(1.0f, in[i], 0.0f);
+
+    const float inv_std = 1.0f / std::sqrt(m2 / n + NORM_EPS);
+    for (size_t i = 0; i < n; ++i)
+        norm[i] = (in[i] - mean) * inv_std;
+
+    return inv_std;
+}
+
+normalization_layer::normalization_layer(size_t size, const std::string& mode, float momentum)
+    : basic_layer(size), momentum(momentum)
 {
+    if (mode != "layer" && mode != "batch")
+        throw std::invalid_argument("Unknown normalization mode: " + mode);
+
+    batch = mode == "batch";
     linear = std::make_unique<linear_layer>(size);
 }
 
@@ -10,38 +73,138 @@ normalization_layer::~normalization_layer()
 
 void normalization_layer::init(size_t prev_size)
 {
+    this->prev_size = prev_size;
+
     // propagate RNG to children (basic_layer::set_gen is non-virtual and was
     // already called on this object by the network, so forward the stored
     // generator to inner layers before they initialize their parameters)
     if (linear)
         linear->set_gen(this->gen);
     linear->init(prev_size);
+
+    // As the first layer the linear part is an identity of the declared size
+    if (batch)
+    {
+        const size_t width = prev_size ? prev_size : size;
+        running_mean.assign(width, 0.0f);
+        running_var.assign(width, 1.0f);
+        batch_inv_std.assign(width, 1.0f);
+    }
+}
+
+void normalization_layer::get_params(vec<std::span<float>>& params)
+{
+    linear->get_params(params);
+}
+
+void normalization_layer::get_buffers(vec<std::span<float>>& buffers)
+{
+    if (batch)
+    {
+        buffers.emplace_back(running_mean);
+        buffers.emplace_back(running_var);
+    }
+}
+
+void normalization_layer::account_memory(layer_memory& m) const
+{
+    linear->account_memory(m);
+    m.kind = "normalization";
+    m.add(m.state, running_mean);
+    m.add(m.state, running_var);
+    m.add(m.activations, last_norm);
+    m.add(m.activations, batch_inv_std);
+    m.add(m.workspace, scratch);
+}
+
+void normalization_layer::set_input_grads(bool needed)
+{
+    need_input_grads = needed;
+    linear->set_input_grads(needed);
+}
+
+bool normalization_layer::has_params() const
+{
+    return linear->has_params();
+}
+
+void normalization_layer::begin_updates()
+{
+    linear->begin_updates();
+}
+
+void normalization_layer::end_updates()
+{
+    linear->end_updates();
+}
+
+// Inference normalization, batch mode uses the frozen running statistics
+void normalization_layer::normalize(const float* in, size_t n, float* norm) const
+{
+    if (!batch)
+    {
+        layer_normalize(in, n, norm);
+        return;
+    }
+
+    if (n != running_mean.size())
+        throw std::runtime_error("normalization_layer expects " + std::to_string(running_mean.size()) +
+                                 " inputs but receives " + std::to_string(n));
+
+    for (size_t i = 0; i < n; ++i)
+        norm[i] = (in[i] - running_mean[i]) / std::sqrt(running_var[i] + NORM_EPS);
+}
+
+void normalization_layer::prune(float sparsity, bool structured)
+{
+    linear->prune(sparsity, structured);
+}
+
+void normalization_layer::compress()
+{
+    linear->compress();
+}
+
+void normalization_layer::replicate()
+{
+    linear->replicate();
 }
 
 vec<float> normalization_layer::forward(const vec<float>& in)
 {
-    float mean = 0.00f;
-    float var = 0.00f;
-    vec<float> norm(in.size());
-    last_input = in;
+    const size_t n = in.size();
+    last_norm.resize(n);
 
-    vec<float> centered(in.size());
-    for (size_t i = 0; i < in.size(); ++i)
-        centered[i] = in[i] - mean;
+    if (!batch)
+    {
+        last_inv_std = layer_normalize(in.data(), n, last_norm.data());
+        return linear->forward(last_norm);
+    }
 
-    for (size_t i = 0 ; i < in.size(); ++i)
-        mean += in[i];
-    mean /= in.size();
+    if (n != running_mean.size())
+        throw std::runtime_error("normalization_layer expects " + std::to_string(running_mean.size()) +
+                                 " inputs but receives " + std::to_string(n));
 
-    for (size_t i = 0; i < in.size(); ++i)
-        var += centered[i] * centered[i];
-    var /= (in.size() - 1);
+    // Exponentially weighted Welford update of the per-feature statistics,
+    // then standardize with them
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float delta = in[i] - running_mean[i];
+        running_mean[i] += momentum * delta;
+        running_var[i] = (1.0f - momentum) * (running_var[i] + momentum * delta * delta);
+
+        batch_inv_std[i] = 1.0f / std::sqrt(running_var[i] + NORM_EPS);
+        last_norm[i] = (in[i] - running_mean[i]) * batch_inv_std[i];
+    }
 
-    float inv_std = 1.0f / std::sqrt(var + 1e-8f);
-    for (size_t i = 0; i < in.size(); ++i)
-        norm[i] = centered[i] * inv_std;
+    return linear->forward(last_norm);
+}
 
-    return linear->forward(norm);
+void normalization_layer::forward_into(const float* in, size_t in_size, float* out)
+{
+    scratch.resize(in_size);
+    normalize(in, in_size, scratch.data());
+    linear->forward_into(scratch.data(), in_size, out);
 }
 
 vec<float> normalization_layer::backprop(const vec<float>& grad, dataset_config_t config)
@@ -49,35 +212,103 @@ vec<float> normalization_layer::backprop(const vec<float>& grad, dataset_config_
     // Backprop through linear layer first
     vec<float> grad_norm = linear->backprop(grad, config);
 
-    size_t n = grad_norm.size();
-    float mean = 0.0f;
-    float var = 0.0f;
-    vec<float> in = last_input; // You need to save the input in forward pass
+    const size_t n = grad_norm.size();
+    if (!need_input_grads || n != last_norm.size())
+        return {};
 
-    for (float v : in)
-        mean += v;
-    mean /= n;
+    vec<float> grad_input(n);
 
-    for (float v : in)
-        var += (v - mean) * (v - mean);
-    var /= (n - 1);
+    // The running statistics move by only `momentum` per sample, treat them as constants
+    if (batch)
+    {
+        for (size_t i = 0; i < n; ++i)
+            grad_input[i] = grad_norm[i] * batch_inv_std[i];
 
-    float eps = 1e-8f;
-    float inv_std = 1.0f / std::sqrt(var + eps);
+        return grad_input;
+    }
 
-    // Compute gradient through normalization
-    float grad_sum = 0.0f;
-    float dot = 0.0f;
+    // Layer norm: dx = inv_std * (g - mean(g) - x_hat * mean(g * x_hat)),
+    // one pass for both reductions and one to write the result
+    float sum_g = 0.0f;
+    float sum_gx = 0.0f;
     for (size_t i = 0; i < n; ++i)
     {
-        grad_sum += grad_norm[i];
-        dot += (in[i] - mean) * grad_norm[i];
+        sum_g += grad_norm[i];
+        sum_gx += grad_norm[i] * last_norm[i];
     }
-    dot /= (n - 1);
 
-    vec<float> grad_input(n);
+    const float mean_g = sum_g / n;
+    const float mean_gx = sum_gx / n;
     for (size_t i = 0; i < n; ++i)
-        grad_input[i] = inv_std * (grad_norm[i] - grad_sum / n - (in[i] - mean) * dot);
+        grad_input[i] = last_inv_std * (grad_norm[i] - mean_g - last_norm[i] * mean_gx);
 
     return grad_input;
 }
+
+std::string normalization_layer::export_cpp(export_writer& w, const std::string& in, size_t in_size)
+{
+    const std::string norm = w.buffer(in_size);
+
+    // must stay in sync with normalize()
+    if (batch)
+    {
+        vec<float> inv_std(running_var.size());
+        for (size_t i = 0; i < inv_std.size(); ++i)
+            inv_std[i] = 1.0f / std::sqrt(running_var[i] + NORM_EPS);
+
+        const std::string M = w.constant("mean", running_mean.data(), running_mean.size());
+        const std::string S = w.constant("inv_std", inv_std.data(), inv_std.size());
+        w.code() << "    for (size_t i = 0; i < " << in_size << "; ++i)\n"
+                 << "        " << norm << "[i] = (" << in << "[i] - " << M << "[i]) * " << S << "[i];\n";
+    }
+    else
+    {
+        // Same lanes, update and merge order as layer_normalize, written out
+        // in scalar code so the exported header rounds like the library
+        const std::string lanes = std::to_string(NORM_LANES);
+        w.helper("normalize",
+            "// Standardize the input over its features, see layer_normalize\n"
+            "inline void normalize(const float* in, float* norm, size_t n)\n"
+            "{\n"
+            "    const size_t blocks = n / " + lanes + ";\n"
+            "    float lane_mean[" + lanes + "] = {};\n"
+            "    float lane_m2[" + lanes + "] = {};\n"
+            "    for (size_t b = 0; b < blocks; ++b)\n"
+            "    {\n"
+            "        for (size_t l = 0; l < " + lanes + "; ++l)\n"
+            "        {\n"
+            "            const float v = in[b * " + lanes + " + l];\n"
+            "            const float delta = v - lane_mean[l];\n"
+            "            lane_mean[l] += delta * (1.0f / (b + 1));\n"
+            "            lane_m2[l] += delta * (v - lane_mean[l]);\n"
+            "        }\n"
+            "    }\n"
+            "\n"
+            "    float count = 0.00f, mean = 0.00f, m2 = 0.00f;\n"
+            "    auto merge = [&](float n_b, float mean_b, float m2_b)\n"
+            "    {\n"
+            "        const float total = count + n_b;\n"
+            "        const float delta = mean_b - mean;\n"
+            "        mean += delta * n_b / total;\n"
+            "        m2 += m2_b + delta * delta * count * n_b / total;\n"
+            "        count = total;\n"
+            "    };\n"
+            "\n"
+            "    if (blocks)\n"
+            "    {\n"
+            "        for (size_t l = 0; l < " + lanes + "; ++l)\n"
+            "            merge(blocks, lane_mean[l], lane_m2[l]);\n"
+            "    }\n"
+            "    for (size_t i = blocks * " + lanes + "; i < n; ++i)\n"
+            "        merge(1.0f, in[i], 0.0f);\n"
+            "\n"
+            "    const float inv_std = 1.0f / std::sqrt(m2 / n + " + float_literal(NORM_EPS) + ");\n"
+            "    for (size_t i = 0; i < n; ++i)\n"
+            "        norm[i] = (in[i] - mean) * inv_std;\n"
+            "}\n");
+
+        w.code() << "    normalize(" << in << ", " << norm << ", " << in_size << ");\n";
+    }
+
+    return linear->export_cpp(w, norm, in_size);
+}
@@ -2,31 +2,192 @@
 #include <iostream>
 #include <iomanip>
 #include <unordered_map>
+#include <chrono>
 #include <SFML/Graphics.hpp>
+#include <unistd.h>
+#include <malloc.h>
 
 #include "nn.hpp"
 #include "math/dataset.hpp"
+#include "math/dataset_stream.hpp"
 
 #include "layers/linear_layer.hpp"
 #include "layers/activation_layer.hpp"
 #include "layers/dense_layer.hpp"
 #include "layers/normalization_layer.hpp"
 #include "layers/gating_layer.hpp"
+#include "layers/conv2d_layer.hpp"
+#include "layers/maxpool_layer.hpp"
+#include "train/data_parallel.hpp"
+#include "train/snapshot.hpp"
+#include "train/pipeline.hpp"
+#include "train/checkpoint.hpp"
+#include "train/autotune.hpp"
+#include "train/sweep.hpp"
+#include "dashboard.hpp"
+#include "numa_memory.hpp"
+#include "memory_report.hpp"
+#include "inference_cache.hpp"
 
 // 2 decimal places
 #define PRECISION 2
 
+#define TRAIN_DATASET "datasets/fashion/fashion_mnist_train.csv"
+#define EPOCHS 50
+
+// Data-parallel ranks must start from identical weights
+#define DATA_PARALLEL_SEED 42
+
+// Fixed so holdout and k-fold splits are reproducible across runs
+#define SPLIT_SEED 7
+
 void show_image(const vec<float>& data, int n, uint width = 28, uint height = 28);
 void print_vector(vec<float> data);
 int argmax(const vec<float>& data);
+int train_data_parallel(int rank, int world);
+int train_streaming(bool conv);
+void report_sparsity(NeuralNetwork& nn, const param_snapshot& dense, const dataset_view& test, float sparsity, bool structured);
+int cross_validate(size_t folds, bool conv);
+int sweep(const std::string& out_path, bool baseline);
+
+std::unique_ptr<NeuralNetwork> build_model(size_t ds, std::optional<uint32_t> seed = {})
+{
+    // normalize, tanh, dense 32 and 16 (tanh), softmax over 10 classes, cce
+    return build_trial_model(sweep_trial_t{}, ds, 10, seed);
+}
+
+// Convolutional model for 28x28 single-channel images
+std::unique_ptr<NeuralNetwork> build_conv_model(std::optional<uint32_t> seed = {})
+{
+    return std::make_unique<NeuralNetwork>(
+        (vec<basic_layer *>){
+            new conv2d_layer(1, 28, 28, 8, 3, 1, 1), // 8 x 28 x 28
+            new activation_layer(8 * 28 * 28, "relu"),
+            new maxpool_layer(8, 28, 28, 2), // 8 x 14 x 14
+            new conv2d_layer(8, 14, 14, 16, 3, 1, 1), // 16 x 14 x 14
+            new activation_layer(16 * 14 * 14, "relu"),
+            new maxpool_layer(16, 14, 14, 2), // 16 x 7 x 7
+            new dense_layer(32, "tanh"), // Dense
+            new dense_layer(10, "softmax") // Output, softmax
+        },
+        "cce",
+        seed
+    );
+}
 
-int main()
+int main(int argc, char** argv)
 {
-    dataset_t dataset = load_csv_dataset("datasets/fashion/fashion_mnist_train.csv", true);
+    int workers = 1;
+    bool conv = false;
+    bool live_validation = false;
+    std::string export_path;
+    bool stream = false;
+    size_t pipeline_stages = 1;
+    std::string checkpoint_dir;
+    float prune_target = 0.0f;
+    bool prune_structured = false;
+    float holdout = 0.0f;
+    size_t folds = 0;
+    bool show_dashboard = false;
+    bool headless = false;
+    bool tune = false;
+    memory_config_t memory;
+    bool numa_report = false;
+    bool replicate = false;
+    bool run_sweep_grid = false;
+    bool sweep_baseline = false;
+    std::string sweep_out;
+    bool memory_table = false;
+    std::string memory_json;
+    size_t cache_mb = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--data-parallel" && i + 1 < argc)
+            workers = std::stoi(argv[++i]);
+        else if (arg == "--conv")
+            conv = true;
+        else if (arg == "--live-validation")
+            live_validation = true;
+        else if (arg == "--export" && i + 1 < argc)
+            export_path = argv[++i];
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg == "--pipeline" && i + 1 < argc)
+            pipeline_stages = std::stoul(argv[++i]);
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpoint_dir = argv[++i];
+        else if (arg == "--prune" && i + 1 < argc)
+            prune_target = std::stof(argv[++i]);
+        else if (arg == "--prune-blocks")
+            prune_structured = true;
+        else if (arg == "--holdout" && i + 1 < argc)
+            holdout = std::stof(argv[++i]);
+        else if (arg == "--folds" && i + 1 < argc)
+            folds = std::stoul(argv[++i]);
+        else if (arg == "--dashboard")
+            show_dashboard = true;
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--autotune")
+            tune = true;
+        else if (arg == "--pages" && i + 1 < argc)
+            memory.pages = argv[++i];
+        else if (arg == "--placement" && i + 1 < argc)
+            memory.placement = argv[++i];
+        else if (arg == "--numa-report")
+            numa_report = true;
+        else if (arg == "--replicate")
+            replicate = true;
+        else if (arg == "--sweep")
+            run_sweep_grid = true;
+        else if (arg == "--sweep-baseline")
+            sweep_baseline = true;
+        else if (arg == "--sweep-out" && i + 1 < argc)
+            sweep_out = argv[++i];
+        else if (arg == "--memory-report")
+            memory_table = true;
+        else if (arg == "--memory-json" && i + 1 < argc)
+            memory_json = argv[++i];
+        else if (arg == "--inference-cache" && i + 1 < argc)
+            cache_mb = std::stoul(argv[++i]);
+    }
+
+    // Before anything allocates parameters
+    try
+    {
+        set_memory_config(memory);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << e.what() << std::endl
+                  << "Usage: --pages none|thp|hugetlb --placement first-touch|interleave" << std::endl;
+        return 1;
+    }
+
+    if (workers > 1)
+        return launch_data_parallel(workers, train_data_parallel);
+    if (stream)
+        return train_streaming(conv);
+    if (folds > 1)
+        return cross_validate(folds, conv);
+    if (run_sweep_grid)
+        return sweep(sweep_out, sweep_baseline);
+
+    dataset_t dataset = load_csv_dataset(TRAIN_DATASET, true);
     dataset.config.lr = 0.01;
     dataset.config.num_batches = 32;
 
-    dataset_t test_dataset = dataset;
+    // Views share the loaded samples. Without --holdout the network is tested
+    // on its own training data as before.
+    dataset_view train_dataset = dataset;
+    dataset_view test_dataset = dataset;
+    if (holdout > 0.0f)
+    {
+        std::mt19937 split_gen(SPLIT_SEED);
+        std::tie(test_dataset, train_dataset) = stratified_split(dataset, holdout, split_gen);
+        std::cout << "Holding out " << test_dataset.size << " samples for testing" << std::endl;
+    }
 
     // Output data size
     size_t ds = dataset.data[0].first.size();
@@ -34,33 +195,483 @@ int main()
     std::cout << "Dataset input size: " <<  dataset.data[0].first.size() << std::endl;
 
     // Create neural network
-    std::unique_ptr<NeuralNetwork> nn = std::make_unique<NeuralNetwork>(
-        (vec<basic_layer *>){
-            new normalization_layer(ds), // Normalize inputs & linear
-            new activation_layer(ds, "tanh"), // Tanh
-            new dense_layer(32, "tanh"), // Dense
-            new dense_layer(16, "tanh"), // Dense
-            new dense_layer(10, "softmax") // Output, softmax
-        },
-        "cce"
-    );
+    std::unique_ptr<NeuralNetwork> nn = conv ? build_conv_model() : build_model(ds);
+
+    const memory_plan inference = nn->compile(ds);
+    const memory_plan training = nn->plan(ds, true);
+    std::cout << "Activation memory: inference " << inference.slab_size * sizeof(float) / 1024 << " KB"
+              << " (unplanned " << inference.naive_size * sizeof(float) / 1024 << " KB), training "
+              << training.slab_size * sizeof(float) / 1024 << " KB per thread"
+              << " (unplanned " << training.naive_size * sizeof(float) / 1024 << " KB)" << std::endl;
+
+    // Where memory goes before training, and per epoch once it runs
+    const bool track_memory = memory_table || !memory_json.empty();
+    epoch_memory_tracker epoch_tracker;
+    vec<epoch_memory> memory_epochs;
+    if (memory_table)
+        write_memory_table(std::cout, make_memory_report(*nn, dataset));
+
+    // Per-machine kernel variants and thread count, benchmarked once and cached
+    if (tune)
+    {
+        const autotune_result tuned = autotune(*nn, train_dataset);
+        train_dataset.config.num_batches = tuned.num_batches;
+        std::cout << "Autotune: " << tuned.tuned << " settings benchmarked, " << tuned.cached
+                  << " from cache, num_batches " << tuned.num_batches << std::endl;
+    }
+
+    // Score published snapshots on a second network while training continues
+    snapshot_channel snapshots;
+    std::unique_ptr<NeuralNetwork> eval_nn;
+    std::unique_ptr<async_validator> validator;
+    if (live_validation)
+    {
+        eval_nn = conv ? build_conv_model() : build_model(ds);
+        validator = std::make_unique<async_validator>(*eval_nn, snapshots, test_dataset,
+            [](uint64_t version, float acc)
+            {
+                std::cout << "Validation after epoch " << version - 1 << " - Accuracy: "
+                          << std::fixed << std::setprecision(PRECISION) << acc * 100 << '%' << std::endl;
+            });
+    }
+
+    // Optionally split the layers over several cores instead of the dataset
+    std::unique_ptr<pipeline_executor> pipeline;
+    if (pipeline_stages > 1)
+    {
+        pipeline_config_t pc;
+        pc.stages = pipeline_stages;
+        pipeline = std::make_unique<pipeline_executor>(*nn, pc);
+    }
+
+    // Resume from the newest checkpoint and keep writing one per epoch
+    std::unique_ptr<checkpointer> checkpoints;
+    uint first_epoch = 0;
+    if (!checkpoint_dir.empty())
+    {
+        if (std::optional<uint64_t> step = checkpointer::resume(*nn, checkpoint_dir))
+        {
+            first_epoch = *step;
+            std::cout << "Resumed from checkpoint after epoch " << first_epoch << std::endl;
+        }
+
+        checkpoint_config_t cc;
+        cc.dir = checkpoint_dir;
+        checkpoints = std::make_unique<checkpointer>(cc);
+    }
+
+    // Live view of the run, fed between epochs without ever blocking training
+    std::unique_ptr<dashboard> view;
+    if (show_dashboard)
+        view = std::make_unique<dashboard>(headless ? std::make_unique<null_renderer>() : make_sfml_renderer());
+
+    memory_profiler profiler;
+    if (numa_report)
+        profiler.start();
+
+    // Dense baseline for the sparsity table, the weights just before the first prune
+    param_snapshot unpruned;
 
     std::cout << "Training MNIST..." << std::endl;
-    const size_t epochs = 50;
-    for (uint i = 0; i < epochs; ++i)
+    const size_t epochs = EPOCHS;
+    for (uint i = first_epoch; i < epochs; ++i)
     {
-        float loss = nn->backprop(dataset);
+        if (track_memory)
+            epoch_tracker.begin();
+        float loss = pipeline ? pipeline->train(train_dataset) : nn->backprop(train_dataset);
+        if (track_memory)
+            memory_epochs.push_back(epoch_tracker.end(i + 1));
+        // Ramp sparsity up over the first 3/4 of training, fine-tune for the rest
+        if (prune_target > 0.0f)
+        {
+            if (i == 0)
+                save_params(*nn, unpruned);
+            nn->prune(prune_schedule(prune_target, i + 1, epochs * 3 / 4), prune_structured);
+        }
+        if (validator)
+            snapshots.publish(*nn);
+        if (checkpoints)
+            checkpoints->save(*nn, i + 1);
+        if (view)
+        {
+            view->publish_metrics(i + 1, loss, validator ? validator->get_accuracy() : -1.0f);
+            view->publish_weights(i + 1, *nn);
+            for (size_t k = 0; k < DASHBOARD_SAMPLES && test_dataset.size; ++k)
+            {
+                const data_pair& sample = test_dataset[(i * DASHBOARD_SAMPLES + k) % test_dataset.size];
+                std::span<const float> out = nn->infer(sample.first);
+                view->publish_sample(i + 1, sample.first,
+                                     std::distance(out.begin(), std::max_element(out.begin(), out.end())),
+                                     label_class(sample));
+            }
+        }
+
         if (i)
         {
             std::cout << "Epoch " << i << "/" << epochs 
                      << " - Loss: " << std::fixed << std::setprecision(PRECISION) 
                      << loss << std::endl;
+            if (memory_table)
+                std::cout << "  Allocations: " << memory_epochs.back().allocations
+                          << ", peak RSS: " << memory_epochs.back().peak_rss / 1024 << " KB" << std::endl;
         }
     }
+    validator.reset();
+    if (numa_report)
+    {
+        profiler.stop();
+        profiler.report(std::cout);
+    }
+    if (view && view->get_dropped())
+        std::cout << "Dashboard dropped " << view->get_dropped() << " updates" << std::endl;
+
+    if (checkpoints)
+    {
+        checkpoints->flush();
+        std::cout << "Checkpoint stall per epoch: mean " << std::fixed << std::setprecision(PRECISION)
+                  << checkpoints->get_mean_stall_us() << " us, max "
+                  << checkpoints->get_max_stall_us() << " us" << std::endl;
+    }
+
+    if (prune_target > 0.0f)
+        nn->compress();
+
+    if (replicate)
+        nn->replicate();
 
     std::cout << "Testing MNIST..." << std::endl;
     float accuracy = nn->test(test_dataset);
     std::cout << "Accuracy: " << accuracy * 100 << '%' << std::endl;
+
+    if (prune_target > 0.0f)
+        report_sparsity(*nn, unpruned, test_dataset, prune_target, prune_structured);
+
+    // Serve the test set twice through the cache, as repeated queries would arrive
+    if (cache_mb)
+    {
+        inference_cache_config_t icc;
+        icc.budget_bytes = cache_mb << 20;
+        inference_cache cache(*nn, icc);
+
+        for (size_t pass = 0; pass < 2; ++pass)
+        {
+            for (size_t k = 0; k < test_dataset.size; ++k)
+                cache.infer(test_dataset[k].first);
+        }
+
+        const inference_cache_stats stats = cache.get_stats();
+        std::cout << "Inference cache: hit rate " << std::fixed << std::setprecision(PRECISION)
+                  << stats.hit_rate() * 100 << "%, " << stats.entries << " entries in "
+                  << stats.bytes / 1024 << " KB, " << stats.evictions << " evictions, saved "
+                  << stats.saved_seconds() * 1000 << " ms" << std::endl;
+    }
+
+    if (track_memory)
+    {
+        memory_report report = make_memory_report(*nn, dataset);
+        report.epochs = std::move(memory_epochs);
+        if (memory_table)
+            write_memory_table(std::cout, report);
+        if (!memory_json.empty())
+        {
+            std::ofstream json(memory_json);
+            write_memory_json(json, report);
+            if (json.flush())
+                std::cout << "Wrote memory report to " << memory_json << std::endl;
+            else
+                std::cerr << "Failed to write the memory report to " << memory_json << std::endl;
+        }
+    }
+
+    if (!export_path.empty())
+    {
+        std::ofstream header(export_path);
+        nn->export_header(header, ds);
+        std::cout << "Exported inference header to " << export_path << std::endl;
+    }
+}
+
+// Accuracy and inference latency of the dense weights from before pruning
+// on the dense kernel, then of the trained weights one-shot pruned to several
+// sparsities on the sparse kernel, restoring the trained weights afterwards.
+// dense is empty when the run resumed past the start of pruning.
+void report_sparsity(NeuralNetwork& nn, const param_snapshot& dense, const dataset_view& test, float sparsity, bool structured)
+{
+    param_snapshot trained;
+    save_params(nn, trained);
+
+    auto report = [&](float level)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        float accuracy = nn.test(test);
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::fixed << std::setprecision(PRECISION)
+                  << std::setw(7) << level * 100 << '%'
+                  << std::setw(10) << accuracy * 100 << '%'
+                  << std::setw(14) << us / test.size << std::endl;
+    };
+
+    if (!dense.buffers.empty())
+        std::cout << "The 0% row runs the weights from before the first prune" << std::endl;
+    std::cout << "Sparsity   Accuracy   Latency (us/sample)" << std::endl;
+    if (!dense.buffers.empty())
+    {
+        // pruning to 0 keeps every weight and drops the compressed copy
+        load_params(nn, dense);
+        nn.prune(0.0f, structured);
+        report(0.0f);
+    }
+
+    vec<float> levels = { sparsity };
+    for (float level : { 0.5f, 0.7f, 0.8f, 0.9f, 0.95f })
+        if (level > sparsity)
+            levels.push_back(level);
+
+    for (float level : levels)
+    {
+        load_params(nn, trained);
+        nn.prune(level, structured);
+        nn.compress();
+        report(level);
+    }
+
+    load_params(nn, trained);
+    nn.prune(sparsity, structured);
+    nn.compress();
+}
+
+// K-fold cross-validation: every fold trains a fresh network on views of the
+// one loaded dataset and scores it on the held-out fold
+int cross_validate(size_t folds, bool conv)
+{
+    dataset_t dataset = load_csv_dataset(TRAIN_DATASET, true);
+    dataset.config.lr = 0.01;
+    dataset.config.num_batches = 32;
+
+    std::mt19937 split_gen(SPLIT_SEED);
+    k_fold splits(dataset, folds, split_gen, true);
+
+    float accuracy_sum = 0.0f;
+    for (size_t f = 0; f < splits.size(); ++f)
+    {
+        auto [train, validation] = splits[f];
+        std::unique_ptr<NeuralNetwork> nn = conv ? build_conv_model() : build_model(dataset.data[0].first.size());
+
+        for (uint i = 0; i < EPOCHS; ++i)
+            nn->backprop(train);
+
+        const float accuracy = nn->test(validation);
+        accuracy_sum += accuracy;
+        std::cout << "Fold " << f + 1 << "/" << splits.size() << " - Accuracy: "
+                  << std::fixed << std::setprecision(PRECISION) << accuracy * 100 << '%' << std::endl;
+    }
+
+    std::cout << "Mean accuracy: " << accuracy_sum / splits.size() * 100 << '%' << std::endl;
+    return 0;
+}
+
+// Hyperparameter sweep: every combination below trains concurrently on the
+// one loaded dataset, losers are stopped early by successive halving. With
+// `baseline` the same sweep runs again one trial at a time for comparison.
+int sweep(const std::string& out_path, bool baseline)
+{
+    dataset_t dataset = load_csv_dataset(TRAIN_DATASET, true);
+
+    vec<sweep_trial_t> trials;
+    for (float lr : { 0.003f, 0.01f, 0.03f })
+    {
+        for (const vec<size_t>& widths : { vec<size_t>{ 32, 16 }, vec<size_t>{ 64, 32 } })
+        {
+            for (const char* activation : { "tanh", "relu" })
+            {
+                sweep_trial_t trial;
+                trial.lr = lr;
+                trial.widths = widths;
+                trial.activation = activation;
+                trial.name = "trial-" + std::to_string(trials.size() + 1);
+                trials.push_back(trial);
+            }
+        }
+    }
+
+    sweep_config_t sc;
+    sc.max_epochs = EPOCHS;
+    sc.seed = SPLIT_SEED;
+
+    // Wall time and peak RSS of one run of the sweep. The heap is trimmed
+    // first so memory an earlier run freed does not count towards the peak.
+    bool peak_reset = true;
+    auto timed_sweep = [&](const sweep_config_t& cfg, double& seconds, size_t& peak_rss)
+    {
+        malloc_trim(0);
+        peak_reset = reset_peak_rss() && peak_reset;
+        const auto start = std::chrono::steady_clock::now();
+        vec<sweep_result_t> results = run_sweep(dataset, trials, cfg);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        peak_rss = get_process_memory().peak_rss;
+        return results;
+    };
+
+    std::cout << "Sweeping " << trials.size() << " configurations..." << std::endl;
+    double seconds = 0.0;
+    size_t peak_rss = 0;
+    const vec<sweep_result_t> results = timed_sweep(sc, seconds, peak_rss);
+
+    write_sweep_table(std::cout, results);
+    if (!out_path.empty())
+    {
+        std::ofstream out(out_path);
+        write_sweep_table(out, results);
+        if (!out.flush())
+        {
+            std::cerr << "Failed to write the sweep table to " << out_path << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote the sweep table to " << out_path << std::endl;
+    }
+
+    double trial_seconds = 0.0;
+    for (const sweep_result_t& r : results)
+        trial_seconds += r.seconds;
+
+    std::cout << std::fixed << std::setprecision(PRECISION)
+              << "Sweep took " << seconds << " s, the trials' own times add up to " << trial_seconds << " s" << std::endl;
+    std::cout << "Peak RSS " << peak_rss / 1024 << " KB" << (peak_reset ? "" : " (since start)")
+              << ", dataset " << memory_usage(dataset).total() / 1024 << " KB shared by all trials" << std::endl;
+
+    if (baseline)
+    {
+        sweep_config_t sequential = sc;
+        sequential.threads = 1;
+
+        std::cout << "Running the same sweep one trial at a time..." << std::endl;
+        double seq_seconds = 0.0;
+        size_t seq_peak_rss = 0;
+        const vec<sweep_result_t> seq_results = timed_sweep(sequential, seq_seconds, seq_peak_rss);
+
+        // Trials are seeded and train on one thread each, so only the timings may differ
+        bool same = results.size() == seq_results.size();
+        for (size_t i = 0; same && i < results.size(); ++i)
+        {
+            same = results[i].trial.name == seq_results[i].trial.name && results[i].epochs == seq_results[i].epochs &&
+                   results[i].loss == seq_results[i].loss && results[i].accuracy == seq_results[i].accuracy;
+        }
+
+        std::cout << "Sequential: " << seq_seconds << " s, peak RSS " << seq_peak_rss / 1024 << " KB" << std::endl;
+        std::cout << "Concurrent: " << seconds << " s (" << seq_seconds / seconds << "x), peak RSS "
+                  << peak_rss / 1024 << " KB" << std::endl;
+        std::cout << "Results " << (same ? "identical" : "differ") << " between the two runs" << std::endl;
+        if (!same)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Train from disk in bounded memory instead of loading the whole dataset
+int train_streaming(bool conv)
+{
+    dataset_config_t config;
+    config.lr = 0.01;
+    config.num_batches = 32;
+
+    dataset_stream stream(std::make_unique<csv_source>(TRAIN_DATASET, true), config);
+
+    dataset_t chunk;
+    if (!stream.next(chunk))
+        throw std::runtime_error("Empty dataset: " TRAIN_DATASET);
+
+    std::unique_ptr<NeuralNetwork> nn = conv ? build_conv_model() : build_model(chunk.data[0].first.size());
+
+    std::cout << "Training MNIST from stream..." << std::endl;
+    for (uint i = 0; i < EPOCHS; ++i)
+    {
+        if (i)
+        {
+            stream.rewind();
+            stream.next(chunk);
+        }
+
+        float loss = 0.0f;
+        size_t seen = 0;
+        do
+        {
+            loss += nn->backprop(chunk) * chunk.size;
+            seen += chunk.size;
+        } while (stream.next(chunk));
+
+        if (i)
+        {
+            std::cout << "Epoch " << i << "/" << EPOCHS
+                     << " - Loss: " << std::fixed << std::setprecision(PRECISION)
+                     << loss / seen << std::endl;
+        }
+    }
+
+    std::cout << "Testing MNIST..." << std::endl;
+    stream.rewind();
+    float correct = 0.0f;
+    size_t seen = 0;
+    while (stream.next(chunk))
+    {
+        correct += nn->test(chunk) * chunk.size;
+        seen += chunk.size;
+    }
+    std::cout << "Accuracy: " << correct / seen * 100 << '%' << std::endl;
+
+    return 0;
+}
+
+// Entry point of one data-parallel rank, each rank loads only its own shard
+int train_data_parallel(int rank, int world)
+{
+    dataset_t shard = load_csv_dataset(TRAIN_DATASET, true, ',', rank, world);
+    shard.config.lr = 0.01;
+    shard.config.num_batches = 1;
+
+    data_parallel_config_t dp;
+    dp.world = world;
+    dp.socket_path += "-" + std::to_string(::getppid());
+
+    ring_allreduce ring(dp.socket_path, rank, world);
+
+    // With more ranks than samples some shards are empty; every rank has to
+    // learn that, or the others would wait on it in the first all-reduce
+    vec<float> empty_shards = { shard.size == 0 ? 1.0f : 0.0f };
+    ring.allreduce(empty_shards);
+    if (empty_shards[0] > 0.0f)
+    {
+        if (rank == 0)
+            std::cerr << "More ranks (" << world << ") than samples, " << empty_shards[0]
+                      << " shards are empty" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<NeuralNetwork> nn = build_model(shard.data[0].first.size(), DATA_PARALLEL_SEED);
+    data_parallel_trainer trainer(*nn, ring, dp.step_size);
+
+    if (rank == 0)
+        std::cout << "Training MNIST on " << world << " processes..." << std::endl;
+
+    for (uint i = 0; i < EPOCHS; ++i)
+    {
+        float loss = trainer.train_epoch(shard);
+        if (rank == 0 && i)
+        {
+            std::cout << "Epoch " << i << "/" << EPOCHS
+                     << " - Loss: " << std::fixed << std::setprecision(PRECISION)
+                     << loss << std::endl;
+        }
+    }
+
+    // Weight every rank's accuracy by its shard size
+    vec<float> correct = { nn->test(shard) * shard.size, (float)shard.size };
+    ring.allreduce(correct);
+    if (rank == 0)
+        std::cout << "Accuracy: " << correct[0] / correct[1] * 100 << '%' << std::endl;
+
+    return 0;
 }
 
 // Display a single MNIST-like image (28x28 pixels) in a window
@@ -0,0 +1,216 @@
+#include "math/dataset_stream.hpp"
+#include <algorithm>
+
+csv_source::csv_source(const std::string& filename, bool has_header, char delimiter)
+    : filename(filename), has_header(has_header), delimiter(delimiter)
+{
+    rewind();
+}
+
+void csv_source::rewind()
+{
+    file.close();
+    file.clear();
+    file.open(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open dataset file: " + filename);
+
+    std::string header;
+    if (has_header)
+        std::getline(file, header);
+}
+
+bool csv_source::read(data_pair& sample)
+{
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (parse_csv_sample(line, delimiter, sample))
+            return true;
+    }
+
+    return false;
+}
+
+static uint32_t read_be32(std::ifstream& file)
+{
+    uint8_t b[4] = {};
+    file.read((char *)b, 4);
+    return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3];
+}
+
+idx_source::idx_source(const std::string& images_path, const std::string& labels_path)
+    : images_path(images_path), labels_path(labels_path)
+{
+    open();
+}
+
+void idx_source::open()
+{
+    images.close();
+    images.clear();
+    labels.close();
+    labels.clear();
+    images.open(images_path, std::ios::binary);
+    labels.open(labels_path, std::ios::binary);
+    if (!images.is_open())
+        throw std::runtime_error("Failed to open dataset file: " + images_path);
+    if (!labels.is_open())
+        throw std::runtime_error("Failed to open dataset file: " + labels_path);
+
+    if (read_be32(images) != 0x803 || read_be32(labels) != 0x801)
+        throw std::runtime_error("Not an IDX image/label file pair: " + images_path + ", " + labels_path);
+
+    count = read_be32(images);
+    const size_t rows = read_be32(images);
+    const size_t cols = read_be32(images);
+    pixels = rows * cols;
+
+    if (read_be32(labels) != count)
+        throw std::runtime_error("IDX image and label counts do not match: " + images_path);
+
+    raw.resize(pixels);
+    read_count = 0;
+}
+
+void idx_source::rewind()
+{
+    open();
+}
+
+bool idx_source::read(data_pair& sample)
+{
+    // Samples with a label that is not a class index are skipped
+    uint8_t label_val = NUM_CLASSES;
+    while (label_val >= NUM_CLASSES)
+    {
+        if (read_count == count)
+            return false;
+
+        images.read((char *)raw.data(), pixels);
+        labels.read((char *)&label_val, 1);
+        if (!images || !labels)
+            return false;
+        ++read_count;
+    }
+
+    sample.first.resize(pixels);
+    for (size_t i = 0; i < pixels; ++i)
+        sample.first[i] = raw[i] / 255.0f;
+
+    sample.second.assign(NUM_CLASSES, 0.0f);
+    sample.second[label_val] = 1.0f;
+    return true;
+}
+
+dataset_stream::dataset_stream(std::unique_ptr<sample_source> source, dataset_config_t train_cfg, stream_config_t cfg)
+    : source(std::move(source)), cfg(cfg), train_cfg(train_cfg), gen(cfg.seed ? cfg.seed : std::random_device{}())
+{
+    if (this->cfg.chunk_size == 0)
+        this->cfg.chunk_size = 1;
+    if (this->cfg.read_ahead == 0)
+        this->cfg.read_ahead = 1;
+
+    reader = std::jthread([this](std::stop_token stop) { produce(stop); });
+}
+
+dataset_stream::~dataset_stream()
+{
+    reader.request_stop();
+    not_full.notify_all();
+}
+
+void dataset_stream::rewind()
+{
+    reader.request_stop();
+    not_full.notify_all();
+    if (reader.joinable())
+        reader.join();
+
+    ready.clear();
+    finished = false;
+    source->rewind();
+    reader = std::jthread([this](std::stop_token stop) { produce(stop); });
+}
+
+bool dataset_stream::next(dataset_t& chunk)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    not_empty.wait(lock, [&] { return !ready.empty() || finished; });
+    if (ready.empty())
+        return false;
+
+    chunk = std::move(ready.front());
+    ready.pop_front();
+    not_full.notify_one();
+    return true;
+}
+
+void dataset_stream::produce(std::stop_token stop)
+{
+    dataset_t chunk;
+    vec<data_pair> window;
+    window.reserve(cfg.shuffle_window);
+
+    // Hand a full chunk to the consumer, waiting while read_ahead chunks are queued
+    auto push = [&]() -> bool
+    {
+        chunk.size = chunk.data.size();
+        chunk.config = train_cfg;
+
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, stop, [&] { return ready.size() < cfg.read_ahead; });
+        if (stop.stop_requested())
+            return false;
+
+        ready.push_back(std::move(chunk));
+        chunk = dataset_t{};
+        chunk.data.reserve(cfg.chunk_size);
+        not_empty.notify_one();
+        return true;
+    };
+
+    auto emit = [&](data_pair&& sample) -> bool
+    {
+        chunk.data.push_back(std::move(sample));
+        return chunk.data.size() < cfg.chunk_size || push();
+    };
+
+    chunk.data.reserve(cfg.chunk_size);
+    data_pair sample;
+    bool running = true;
+    while (running && !stop.stop_requested() && source->read(sample))
+    {
+        if (window.size() < cfg.shuffle_window)
+        {
+            window.push_back(std::move(sample));
+            continue;
+        }
+
+        if (cfg.shuffle_window == 0)
+        {
+            running = emit(std::move(sample));
+            continue;
+        }
+
+        // Emit a random sample from the window and put the new one in its place
+        const size_t idx = std::uniform_int_distribution<size_t>(0, window.size() - 1)(gen);
+        running = emit(std::move(window[idx]));
+        window[idx] = std::move(sample);
+    }
+
+    std::shuffle(window.begin(), window.end(), gen);
+    for (auto& s : window)
+    {
+        if (!running)
+            break;
+        running = emit(std::move(s));
+    }
+
+    if (running && !chunk.data.empty())
+        push();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    finished = true;
+    not_empty.notify_all();
+}
@@ -0,0 +1,109 @@
+#include "memory_planner.hpp"
+#include <algorithm>
+#include <numeric>
+
+static size_t align_up(size_t n)
+{
+    return (n + PLAN_ALIGN - 1) / PLAN_ALIGN * PLAN_ALIGN;
+}
+
+// Place buffers largest first, each at the lowest offset that does not
+// overlap a buffer which is alive at the same time
+static size_t assign_offsets(vec<buffer_plan>& buffers)
+{
+    vec<size_t> order(buffers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buffers[a].size > buffers[b].size;
+    });
+
+    vec<size_t> placed;
+    size_t slab = 0;
+    for (size_t b : order)
+    {
+        buffer_plan& buf = buffers[b];
+
+        vec<size_t> live;
+        for (size_t p : placed)
+        {
+            if (buffers[p].first_use <= buf.last_use && buf.first_use <= buffers[p].last_use)
+                live.push_back(p);
+        }
+        std::sort(live.begin(), live.end(), [&](size_t x, size_t y) {
+            return buffers[x].offset < buffers[y].offset;
+        });
+
+        size_t offset = 0;
+        for (size_t p : live)
+        {
+            if (offset + align_up(buf.size) <= buffers[p].offset)
+                break;
+            offset = std::max(offset, buffers[p].offset + align_up(buffers[p].size));
+        }
+
+        buf.offset = offset;
+        slab = std::max(slab, offset + align_up(buf.size));
+        placed.push_back(b);
+    }
+
+    return slab;
+}
+
+memory_plan plan_memory(const vec<size_t>& sizes, const vec<bool>& inplace, bool training, size_t first_grad)
+{
+    memory_plan plan;
+    const size_t L = sizes.size() - 1;
+
+    // Activations: written at step l - 1, read by layer l forward and, when
+    // training, kept until layer l - 1 backward reads them as its output
+    for (size_t l = 0; l <= L; ++l)
+    {
+        plan.naive_size += sizes[l];
+
+        const size_t first = l ? l - 1 : 0;
+        const size_t last = !training ? l : 2 * L - (l ? l - 1 : 0);
+
+        if (!training && l > 0 && inplace[l - 1] && sizes[l] == sizes[l - 1])
+        {
+            // layer l - 1 writes over its own input, which dies at this step
+            buffer_plan& in = plan.buffers[plan.activations[l - 1]];
+            in.name += "," + std::to_string(l);
+            in.last_use = last;
+            plan.activations.push_back(plan.activations[l - 1]);
+            continue;
+        }
+
+        plan.activations.push_back(plan.buffers.size());
+        plan.buffers.push_back({ "act " + std::to_string(l), sizes[l], 0, first, last });
+    }
+
+    // Gradients: d loss / d activation l is written by the loss (l = L) or by
+    // layer l backward at step 2L - l, and read by layer l - 1 backward
+    plan.gradients.assign(L + 1, SIZE_MAX);
+    if (training)
+    {
+        for (size_t l = L; l >= std::max<size_t>(first_grad, 1); --l)
+        {
+            plan.naive_size += sizes[l];
+
+            const size_t first = 2 * L - l;
+            const size_t last = first + 1;
+
+            if (l < L && inplace[l] && sizes[l] == sizes[l + 1])
+            {
+                // layer l writes its input gradient over the one it received
+                buffer_plan& out = plan.buffers[plan.gradients[l + 1]];
+                out.name += "," + std::to_string(l);
+                out.last_use = last;
+                plan.gradients[l] = plan.gradients[l + 1];
+                continue;
+            }
+
+            plan.gradients[l] = plan.buffers.size();
+            plan.buffers.push_back({ "grad " + std::to_string(l), sizes[l], 0, first, last });
+        }
+    }
+
+    plan.slab_size = assign_offsets(plan.buffers);
+    return plan;
+}
@@ -0,0 +1,178 @@
+#include "memory_report.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <malloc.h>
+
+// Shards of the allocation counter, so training threads allocating at once
+// do not all bounce one cache line
+#define ALLOC_COUNTER_SHARDS 64
+
+struct alignas(64) alloc_counter
+{
+    std::atomic<size_t> n{0};
+};
+
+static alloc_counter alloc_counts[ALLOC_COUNTER_SHARDS];
+static std::atomic<size_t> next_shard{0};
+
+void count_allocation()
+{
+    static thread_local const size_t shard = next_shard++ % ALLOC_COUNTER_SHARDS;
+    alloc_counts[shard].n.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t allocation_count()
+{
+    size_t total = get_memory_stats().allocations;
+    for (const alloc_counter& c : alloc_counts)
+        total += c.n.load(std::memory_order_relaxed);
+    return total;
+}
+
+// "VmRSS:  1416 kB" style field of /proc/self/status, in bytes
+static size_t status_bytes(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.starts_with(field + ":"))
+            return std::stoull(line.substr(field.size() + 1)) * 1024;
+    }
+
+    return 0;
+}
+
+process_memory get_process_memory()
+{
+    process_memory m;
+    m.rss = status_bytes("VmRSS");
+    m.peak_rss = status_bytes("VmHWM");
+
+    const struct mallinfo2 info = ::mallinfo2();
+    m.heap_in_use = info.uordblks + info.hblkhd;
+    m.heap_free = info.fordblks;
+
+    m.numa = get_memory_stats();
+    m.allocations = allocation_count();
+    return m;
+}
+
+bool reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    return clear_refs && (clear_refs << "5").flush();
+}
+
+void epoch_memory_tracker::begin()
+{
+    reset_peak_rss();
+    start_allocations = allocation_count();
+}
+
+epoch_memory epoch_memory_tracker::end(size_t epoch)
+{
+    epoch_memory m;
+    m.epoch = epoch;
+    m.allocations = allocation_count() - start_allocations;
+
+    const process_memory p = get_process_memory();
+    m.rss = p.rss;
+    m.peak_rss = p.peak_rss;
+    return m;
+}
+
+memory_report make_memory_report(const NeuralNetwork& nn, const dataset_t& dataset)
+{
+    memory_report report;
+    report.layers = nn.memory_usage();
+    report.dataset = memory_usage(dataset);
+    report.process = get_process_memory();
+    return report;
+}
+
+void write_memory_table(std::ostream& os, const memory_report& report)
+{
+    const auto kb = [](size_t bytes) { return (double)bytes / 1024; };
+    const auto old_flags = os.flags();
+    const auto old_precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+    os << std::left << std::setw(7) << "Layer" << std::setw(15) << "Kind" << std::right
+       << std::setw(11) << "Params" << std::setw(11) << "Grads" << std::setw(13) << "Activations"
+       << std::setw(11) << "Optimizer" << std::setw(11) << "State" << std::setw(11) << "Workspace"
+       << std::setw(11) << "Overhead" << std::setw(11) << "Total" << "  (KB)" << std::endl;
+
+    layer_memory sum;
+    sum.kind = "total";
+    for (size_t l = 0; l <= report.layers.size(); ++l)
+    {
+        const bool last = l == report.layers.size();
+        const layer_memory& m = last ? sum : report.layers[l];
+
+        os << std::left << std::setw(7) << (last || m.kind == "network" ? "" : std::to_string(l)) << std::setw(15) << m.kind
+           << std::right << std::setw(11) << kb(m.parameters) << std::setw(11) << kb(m.gradients)
+           << std::setw(13) << kb(m.activations) << std::setw(11) << kb(m.optimizer)
+           << std::setw(11) << kb(m.state) << std::setw(11) << kb(m.workspace) << std::setw(11) << kb(m.overhead)
+           << std::setw(11) << kb(m.total()) << std::endl;
+
+        if (!last)
+        {
+            sum.parameters += m.parameters;
+            sum.gradients += m.gradients;
+            sum.activations += m.activations;
+            sum.optimizer += m.optimizer;
+            sum.state += m.state;
+            sum.workspace += m.workspace;
+            sum.overhead += m.overhead;
+        }
+    }
+
+    const dataset_memory& d = report.dataset;
+    const process_memory& p = report.process;
+    os << "Dataset: inputs " << kb(d.inputs) << " KB, labels " << kb(d.labels)
+       << " KB, overhead " << kb(d.overhead) << " KB" << std::endl;
+    os << "Process: RSS " << kb(p.rss) << " KB, peak " << kb(p.peak_rss)
+       << " KB, heap in use " << kb(p.heap_in_use) << " KB, heap held free " << kb(p.heap_free)
+       << " KB, mapped " << kb(p.numa.mapped_bytes) << " KB, allocations " << p.allocations << std::endl;
+
+    os.flags(old_flags);
+    os.precision(old_precision);
+}
+
+void write_memory_json(std::ostream& os, const memory_report& report)
+{
+    os << "{\n  \"layers\": [";
+    for (size_t l = 0; l < report.layers.size(); ++l)
+    {
+        const layer_memory& m = report.layers[l];
+        os << (l ? "," : "") << "\n    {\"kind\": \"" << m.kind << "\", \"parameters\": " << m.parameters
+           << ", \"gradients\": " << m.gradients << ", \"activations\": " << m.activations
+           << ", \"optimizer\": " << m.optimizer << ", \"state\": " << m.state
+           << ", \"workspace\": " << m.workspace
+           << ", \"overhead\": " << m.overhead << ", \"total\": " << m.total() << "}";
+    }
+    os << "\n  ],\n";
+
+    const dataset_memory& d = report.dataset;
+    os << "  \"dataset\": {\"inputs\": " << d.inputs << ", \"labels\": " << d.labels
+       << ", \"overhead\": " << d.overhead << ", \"total\": " << d.total() << "},\n";
+
+    const process_memory& p = report.process;
+    os << "  \"process\": {\"rss\": " << p.rss << ", \"peak_rss\": " << p.peak_rss
+       << ", \"heap_in_use\": " << p.heap_in_use << ", \"heap_free\": " << p.heap_free
+       << ", \"mapped\": " << p.numa.mapped_bytes << ", \"hugetlb\": " << p.numa.hugetlb_bytes << ", \"allocations\": " << p.allocations << "},\n";
+
+    os << "  \"epochs\": [";
+    for (size_t e = 0; e < report.epochs.size(); ++e)
+    {
+        const epoch_memory& m = report.epochs[e];
+        os << (e ? "," : "") << "\n    {\"epoch\": " << m.epoch << ", \"allocations\": " << m.allocations
+           << ", \"rss\": " << m.rss << ", \"peak_rss\": " << m.peak_rss << "}";
+    }
+    os << (report.epochs.empty() ? "]\n" : "\n  ]\n") << "}" << std::endl;
+}
@@ -1,15 +1,19 @@
 #include "nn.hpp"
+#include "export.hpp"
 
-NeuralNetwork::NeuralNetwork(vec<basic_layer *> layers_, const std::string& loss_type)
+NeuralNetwork::NeuralNetwork(vec<basic_layer *> layers_, const std::string& loss_type, std::optional<uint32_t> seed)
 {
-    gen = std::make_shared<std::mt19937>(rd());
-    loss_functions = get_loss(loss_type);
+    gen = std::make_shared<std::mt19937>(seed ? *seed : rd());
+    loss_fn = get_loss(loss_type);
     for (auto& layer : layers_)
         add_layer(layer);
 }
 
 NeuralNetwork::~NeuralNetwork()
-{}
+{
+    for (basic_layer* layer : layers)
+        delete layer;
+}
 
 vec<float> NeuralNetwork::forward(vec<float> in)
 {
@@ -20,71 +24,323 @@ vec<float> NeuralNetwork::forward(vec<float> in)
     return out;
 }
 
-float NeuralNetwork::backprop(const dataset_t& dataset)
+float NeuralNetwork::backprop(const dataset_view& dataset)
 {
     size_t batch_count = dataset.config.num_batches;
     if (batch_count == 0) batch_count = 1;
 
     size_t batch_size = (dataset.size + batch_count - 1) / batch_count;
-    float loss_total = 0.0f;
-    std::mutex mtx; // for safely accumulating loss
 
-    auto worker = [&](size_t start, size_t end)
-    {
-        float thread_loss = 0.0f;
+    // Every thread owns one slot, summed after the join
+    vec<float> batch_loss(batch_count, 0.0f);
 
-        // Create local copies of layers for gradient accumulation
-        vec<vec2<float>> weight_grads(layers.size());
-        vec<vec<float>> bias_grads(layers.size());
+    if (dataset.size == 0)
+        return 0.0f;
 
-        for (size_t i = start; i < end; ++i)
-        {
-            const vec<float>& X = dataset.data[i].first;
-            const vec<float>& Y = dataset.data[i].second;
-
-            vec<float> out = this->forward(X);
-            thread_loss += loss_functions.loss(out, Y);
-
-            vec<float> grad = loss_functions.grad(Y, out);
-
-            for (int l = layers.size() - 1; l >= 0; --l)
-                grad = layers[l]->backprop(grad, dataset.config);
-        }
-
-        // Accumulate loss
-        std::lock_guard<std::mutex> lock(mtx);
-        loss_total += thread_loss;
-    };
+    prepare_training(dataset[0].first.size(), batch_count);
+    begin_training();
 
     std::vector<std::thread> threads;
     for (size_t b = 0; b < batch_count; ++b)
     {
         size_t start = b * batch_size;
         size_t end = std::min(start + batch_size, dataset.size);
-        threads.emplace_back(worker, start, end);
+        float* slab = training_slab(b);
+        threads.emplace_back([&, b, start, end, slab] { batch_loss[b] = train_samples(dataset, start, end, slab); });
     }
 
     for (auto& t : threads)
         t.join();
 
+    end_training();
+
+    float loss_total = 0.0f;
+    for (float loss : batch_loss)
+        loss_total += loss;
+
     return loss_total / dataset.size;
 }
 
-float NeuralNetwork::test(const dataset_t& test)
+float NeuralNetwork::train_range(const dataset_view& dataset, size_t start, size_t end)
+{
+    if (start >= end)
+        return 0.0f;
+
+    prepare_training(dataset[start].first.size(), 1);
+    begin_training();
+    const float loss = train_samples(dataset, start, end, training_slab(0));
+    end_training();
+    return loss;
+}
+
+void NeuralNetwork::begin_training()
+{
+    for (auto& layer : layers)
+        layer->begin_updates();
+}
+
+void NeuralNetwork::end_training()
+{
+    for (auto& layer : layers)
+        layer->end_updates();
+    mark_weights_changed();
+}
+
+float NeuralNetwork::train_samples(const dataset_view& dataset, size_t start, size_t end, float* slab)
+{
+    const memory_plan& p = training_plan;
+    const size_t L = layers.size();
+    auto size = [&](size_t l) { return p.buffers[p.activations[l]].size; };
+    auto act = [&](size_t l) { return slab + p.buffers[p.activations[l]].offset; };
+    auto grad = [&](size_t l) {
+        return p.gradients[l] == SIZE_MAX ? nullptr : slab + p.buffers[p.gradients[l]].offset;
+    };
+
+    float loss = 0.0f;
+    for (size_t i = start; i < end; ++i)
+    {
+        const vec<float>& X = dataset[i].first;
+        const vec<float>& Y = dataset[i].second;
+
+        std::copy(X.begin(), X.end(), act(0));
+        for (size_t l = 0; l < L; ++l)
+            layers[l]->train_into(act(l), size(l), act(l + 1));
+
+        loss += loss_fn(act(L), Y.data(), grad(L), 1, size(L));
+
+        // layers before the first one with parameters get no gradient
+        for (size_t l = L; l-- > 0 && grad(l + 1); )
+            layers[l]->backprop_into(act(l), size(l), act(l + 1), grad(l + 1), grad(l), dataset.config);
+    }
+
+    return loss;
+}
+
+vec<std::span<float>> NeuralNetwork::get_params()
+{
+    mark_weights_changed();
+
+    vec<std::span<float>> params;
+    for (auto& layer : layers)
+        layer->get_params(params);
+
+    return params;
+}
+
+vec<std::span<float>> NeuralNetwork::get_buffers()
+{
+    mark_weights_changed();
+
+    vec<std::span<float>> buffers;
+    for (auto& layer : layers)
+        layer->get_buffers(buffers);
+
+    return buffers;
+}
+
+vec<std::span<const float>> NeuralNetwork::view_params() const
+{
+    vec<std::span<const float>> params;
+    for (const basic_layer* layer : layers)
+    {
+        vec<std::span<const float>> p = layer->view_params();
+        params.insert(params.end(), p.begin(), p.end());
+    }
+
+    return params;
+}
+
+vec<std::span<const float>> NeuralNetwork::view_buffers() const
+{
+    vec<std::span<const float>> buffers;
+    for (const basic_layer* layer : layers)
+    {
+        vec<std::span<const float>> b = layer->view_buffers();
+        buffers.insert(buffers.end(), b.begin(), b.end());
+    }
+
+    return buffers;
+}
+
+vec<layer_memory> NeuralNetwork::memory_usage() const
+{
+    vec<layer_memory> usage(layers.size() + 1);
+    for (size_t l = 0; l < layers.size(); ++l)
+        layers[l]->account_memory(usage[l]);
+
+    usage.back().kind = "network";
+    usage.back().add(usage.back().workspace, slab);
+    for (const numa_buffer& b : training_slabs)
+        usage.back().add(usage.back().activations, b);
+    return usage;
+}
+
+void NeuralNetwork::prune(float sparsity, bool structured)
+{
+    for (auto& layer : layers)
+        layer->prune(sparsity, structured);
+    mark_weights_changed();
+}
+
+void NeuralNetwork::compress()
+{
+    for (auto& layer : layers)
+        layer->compress();
+    mark_weights_changed();
+}
+
+void NeuralNetwork::replicate()
+{
+    for (auto& layer : layers)
+        layer->replicate();
+}
+
+float NeuralNetwork::test(const dataset_view& test)
 {
     size_t correct = 0;
 
-    for (size_t i = 0; i < test.size; ++i)
+    for (size_t start = 0; start < test.size; start += TEST_BATCH)
     {
-        vec<float> out = forward(test.data[i].first);
+        const size_t count = std::min<size_t>(TEST_BATCH, test.size - start);
+        std::span<const float> outs = infer_batch(test, start, count);
+        const size_t out_size = outs.size() / count;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const data_pair& sample = test[start + i];
+            std::span<const float> out = outs.subspan(i * out_size, out_size);
 
-        // find index of max output neuron
-        size_t predicted = std::distance(out.begin(), std::max_element(out.begin(), out.end()));
-        size_t actual    = std::distance(test.data[i].second.begin(), std::max_element(test.data[i].second.begin(), test.data[i].second.end()));
+            // find index of max output neuron
+            size_t predicted = std::distance(out.begin(), std::max_element(out.begin(), out.end()));
+            size_t actual    = std::distance(sample.second.begin(), std::max_element(sample.second.begin(), sample.second.end()));
 
-        if (predicted == actual)
-            ++correct;
+            if (predicted == actual)
+                ++correct;
+        }
     }
 
     return static_cast<float>(correct) / test.size;
 }
+
+vec<size_t> NeuralNetwork::infer_shapes(size_t input_size)
+{
+    vec<size_t> sizes = { input_size };
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        const size_t expected = layers[l]->get_prev_size();
+        if (expected != 0 && expected != sizes.back())
+            throw std::runtime_error("Layer " + std::to_string(l) + " expects " + std::to_string(expected) +
+                                     " inputs but receives " + std::to_string(sizes.back()));
+
+        sizes.push_back(layers[l]->get_size());
+    }
+
+    return sizes;
+}
+
+memory_plan NeuralNetwork::plan(size_t input_size, bool training)
+{
+    vec<size_t> sizes = infer_shapes(input_size);
+    vec<bool> inplace(layers.size());
+    for (size_t l = 0; l < layers.size(); ++l)
+        inplace[l] = layers[l]->supports_inplace();
+
+    // The input gradient of a layer is only needed if an earlier one has parameters
+    size_t first_grad = layers.size();
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        if (layers[l]->has_params())
+        {
+            first_grad = std::min(l + 1, layers.size());
+            break;
+        }
+    }
+
+    return plan_memory(sizes, inplace, training, first_grad);
+}
+
+// Point past the start of b so the first buffer starts on a cache line
+static float* align_slab(numa_buffer& b, size_t floats)
+{
+    void* base = b.data();
+    size_t space = b.size() * sizeof(float);
+    return (float *)std::align(PLAN_ALIGN * sizeof(float), floats * sizeof(float), base, space);
+}
+
+const memory_plan& NeuralNetwork::compile(size_t input_size, size_t batch)
+{
+    compiled_plan = plan(input_size);
+    compiled_batch = std::max<size_t>(batch, 1);
+
+    // over-allocate so the first buffer can start on a cache line
+    slab = numa_buffer(compiled_plan.slab_size * compiled_batch + PLAN_ALIGN);
+    slab_base = align_slab(slab, compiled_plan.slab_size * compiled_batch);
+
+    return compiled_plan;
+}
+
+void NeuralNetwork::prepare_training(size_t input_size, size_t threads)
+{
+    if (training_plan.buffers.empty() || training_plan.buffers[training_plan.activations[0]].size != input_size)
+    {
+        training_plan = plan(input_size, true);
+        training_slabs.clear();
+    }
+
+    while (training_slabs.size() < threads)
+        training_slabs.emplace_back(training_plan.slab_size + PLAN_ALIGN);
+}
+
+float* NeuralNetwork::training_slab(size_t thread)
+{
+    return align_slab(training_slabs[thread], training_plan.slab_size);
+}
+
+std::span<const float> NeuralNetwork::infer(std::span<const float> in)
+{
+    const memory_plan& p = compiled_plan;
+    if (!slab_base || p.buffers[p.activations[0]].size != in.size())
+        compile(in.size());
+
+    auto buffer = [&](size_t act) { return slab_base + p.buffers[p.activations[act]].offset * compiled_batch; };
+
+    std::copy(in.begin(), in.end(), buffer(0));
+    for (size_t l = 0; l < layers.size(); ++l)
+        layers[l]->forward_into(buffer(l), p.buffers[p.activations[l]].size, buffer(l + 1));
+
+    return { buffer(layers.size()), p.buffers[p.activations.back()].size };
+}
+
+std::span<const float> NeuralNetwork::infer_batch(const dataset_view& data, size_t start, size_t count)
+{
+    if (count == 0)
+        return {};
+
+    const size_t in_size = data[start].first.size();
+    if (!slab_base || compiled_plan.buffers[compiled_plan.activations[0]].size != in_size || compiled_batch < count)
+        compile(in_size, std::max(count, compiled_batch));
+
+    // buffers are planned per sample, scaling them keeps the plan's reuse
+    const memory_plan& p = compiled_plan;
+    auto size = [&](size_t l) { return p.buffers[p.activations[l]].size; };
+    auto buffer = [&](size_t act) { return slab_base + p.buffers[p.activations[act]].offset * compiled_batch; };
+
+    for (size_t i = 0; i < count; ++i)
+        std::copy(data[start + i].first.begin(), data[start + i].first.end(), buffer(0) + i * in_size);
+    for (size_t l = 0; l < layers.size(); ++l)
+        layers[l]->forward_batch_into(buffer(l), size(l), count, buffer(l + 1), size(l + 1));
+
+    return { buffer(layers.size()), count * size(layers.size()) };
+}
+
+void NeuralNetwork::export_header(std::ostream& os, size_t input_size, const std::string& ns)
+{
+    vec<size_t> sizes = infer_shapes(input_size);
+
+    export_writer w;
+    std::string buf = "in";
+    for (size_t l = 0; l < layers.size(); ++l)
+        buf = layers[l]->export_cpp(w, buf, sizes[l]);
+
+    os << w.str(ns, input_size, sizes.back(), buf);
+}
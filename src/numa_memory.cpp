@@ -0,0 +1,382 @@
+#include "numa_memory.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <utility>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// From <numaif.h>, which needs libnuma installed
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_INTERLEAVE 3
+
+static memory_config_t config;
+
+static std::atomic<size_t> num_allocations{0};
+static std::atomic<size_t> mapped_bytes{0};
+static std::atomic<size_t> hugetlb_bytes{0};
+static std::atomic<size_t> heap_bytes{0};
+
+// Length and page kind of every live mapping, needed again by munmap
+struct mapping_t
+{
+    size_t len;
+    bool hugetlb;
+};
+
+static std::mutex mappings_mtx;
+static std::unordered_map<void*, mapping_t> mappings;
+
+void set_memory_config(const memory_config_t& cfg)
+{
+    if (cfg.pages != "none" && cfg.pages != "thp" && cfg.pages != "hugetlb")
+        throw std::invalid_argument("Unknown page policy: " + cfg.pages);
+    if (cfg.placement != "first-touch" && cfg.placement != "interleave")
+        throw std::invalid_argument("Unknown NUMA placement: " + cfg.placement);
+
+    config = cfg;
+}
+
+const memory_config_t& get_memory_config()
+{
+    return config;
+}
+
+// Parse a sysfs cpulist such as "0-15,32-47"
+static vec<int> parse_cpulist(const std::string& list)
+{
+    vec<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty())
+            continue;
+
+        const size_t dash = range.find('-');
+        const int lo = std::stoi(range.substr(0, dash));
+        const int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int c = lo; c <= hi; ++c)
+            cpus.push_back(c);
+    }
+
+    return cpus;
+}
+
+vec<vec<int>> numa_nodes()
+{
+    vec<vec<int>> nodes;
+    for (int n = 0; ; ++n)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if (!file.is_open())
+            break;
+
+        std::string list;
+        std::getline(file, list);
+        vec<int> cpus = parse_cpulist(list);
+        if (!cpus.empty())
+            nodes.push_back(cpus);
+    }
+
+    return nodes;
+}
+
+
+// Nodes with memory, counted once; cpu-less nodes are included here
+static size_t memory_node_count()
+{
+    static const size_t count = []
+    {
+        size_t n = 0;
+        while (std::ifstream("/sys/devices/system/node/node" + std::to_string(n) + "/meminfo").is_open())
+            ++n;
+        return n;
+    }();
+
+    return count;
+}
+
+int current_numa_node()
+{
+    unsigned cpu = 0, node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return 0;
+    return (int)node;
+}
+
+static long mbind(void* addr, size_t len, int mode, const unsigned long* mask, size_t max_node)
+{
+    return ::syscall(SYS_mbind, addr, len, mode, mask, max_node, 0);
+}
+
+void* numa_alloc(size_t bytes, int node)
+{
+    if (bytes == 0)
+        return nullptr;
+
+    ++num_allocations;
+    if (bytes < NUMA_MIN_MAP_BYTES)
+    {
+        void* p = std::calloc(1, bytes);
+        if (!p)
+            throw std::bad_alloc();
+        heap_bytes += bytes;
+        return p;
+    }
+
+    // Whole huge pages, so the tail of a buffer never shares a page with a
+    // neighbour, but only for buffers that fill at least one
+    const bool huge = config.pages != "none" && bytes >= HUGE_PAGE_BYTES;
+    const size_t page = huge ? HUGE_PAGE_BYTES : (size_t)::sysconf(_SC_PAGESIZE);
+    const size_t len = (bytes + page - 1) / page * page;
+
+    bool hugetlb = false;
+    void* p = MAP_FAILED;
+    if (huge && config.pages == "hugetlb")
+    {
+        p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugetlb = p != MAP_FAILED;
+    }
+    if (p == MAP_FAILED)
+        p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+
+    if (huge && !hugetlb)
+        ::madvise(p, len, MADV_HUGEPAGE);
+
+    // The policy is set before anything touches the pages, which places them
+    const size_t nodes = memory_node_count();
+    if (nodes > 1 && (node >= 0 || config.placement == "interleave"))
+    {
+        vec<unsigned long> mask((nodes + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)), 0);
+        for (size_t n = 0; n < nodes; ++n)
+        {
+            if (node < 0 || (size_t)node == n)
+                mask[n / (8 * sizeof(unsigned long))] |= 1ul << (n % (8 * sizeof(unsigned long)));
+        }
+        mbind(p, len, node >= 0 ? NUMA_MPOL_BIND : NUMA_MPOL_INTERLEAVE, mask.data(), nodes + 1);
+    }
+
+    mapped_bytes += len;
+    if (hugetlb)
+        hugetlb_bytes += len;
+
+    std::lock_guard<std::mutex> lock(mappings_mtx);
+    mappings[p] = { len, hugetlb };
+    return p;
+}
+
+void numa_free(void* p, size_t bytes)
+{
+    if (!p)
+        return;
+
+    if (bytes < NUMA_MIN_MAP_BYTES)
+    {
+        std::free(p);
+        heap_bytes -= bytes;
+        return;
+    }
+
+    mapping_t m;
+    {
+        std::lock_guard<std::mutex> lock(mappings_mtx);
+        auto it = mappings.find(p);
+        if (it == mappings.end())
+            return;
+        m = it->second;
+        mappings.erase(it);
+    }
+
+    ::munmap(p, m.len);
+    mapped_bytes -= m.len;
+    if (m.hugetlb)
+        hugetlb_bytes -= m.len;
+}
+
+size_t numa_allocated_bytes(const void* p, size_t bytes)
+{
+    if (!p || bytes < NUMA_MIN_MAP_BYTES)
+        return bytes;
+
+    std::lock_guard<std::mutex> lock(mappings_mtx);
+    auto it = mappings.find(const_cast<void*>(p));
+    return it == mappings.end() ? bytes : it->second.len;
+}
+
+memory_stats get_memory_stats()
+{
+    memory_stats stats;
+    stats.allocations = num_allocations.load();
+    stats.mapped_bytes = mapped_bytes.load();
+    stats.hugetlb_bytes = hugetlb_bytes.load();
+    stats.heap_bytes = heap_bytes.load();
+    return stats;
+}
+
+// Starts zeroed: heap buffers by calloc, fresh mappings by the kernel
+numa_buffer::numa_buffer(size_t size, int node)
+    : ptr((float *)numa_alloc(size * sizeof(float), node)), n(size), node(node)
+{}
+
+numa_buffer::~numa_buffer()
+{
+    numa_free(ptr, n * sizeof(float));
+}
+
+numa_buffer::numa_buffer(const numa_buffer& other) : numa_buffer(other.n, other.node)
+{
+    if (n)
+        std::memcpy(ptr, other.ptr, n * sizeof(float));
+}
+
+numa_buffer::numa_buffer(numa_buffer&& other) noexcept
+    : ptr(std::exchange(other.ptr, nullptr)), n(std::exchange(other.n, 0)), node(std::exchange(other.node, -1))
+{}
+
+numa_buffer& numa_buffer::operator=(numa_buffer other) noexcept
+{
+    std::swap(ptr, other.ptr);
+    std::swap(n, other.n);
+    std::swap(node, other.node);
+    return *this;
+}
+
+// Hardware cache event ids for perf_event_open
+static uint64_t cache_event(uint64_t cache, uint64_t result)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+memory_profiler::memory_profiler()
+{
+    const uint64_t events[4] = {
+        cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+        cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS),
+        cache_event(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+        cache_event(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = events[i];
+        attr.disabled = 1;
+        attr.inherit = 1; // count the training threads started later too
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fds[i] = (int)::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+memory_profiler::~memory_profiler()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+}
+
+void memory_profiler::start()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void memory_profiler::stop()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+            ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void memory_profiler::report(std::ostream& os) const
+{
+    uint64_t counts[4] = {};
+    bool available[4] = {};
+    for (size_t i = 0; i < 4; ++i)
+        available[i] = fds[i] >= 0 && ::read(fds[i], &counts[i], sizeof(counts[i])) == sizeof(counts[i]);
+
+    auto rate = [&](size_t access, size_t miss, const char* name)
+    {
+        os << name << ": ";
+        if (available[access] && available[miss] && counts[access] > 0)
+            os << std::fixed << std::setprecision(2) << 100.0 * counts[miss] / counts[access] << "% of "
+               << counts[access] << " loads" << std::endl;
+        else
+            os << "unavailable" << std::endl;
+    };
+    rate(0, 1, "dTLB miss rate");
+    rate(2, 3, "Remote node access rate");
+
+    // Resident pages per node over all mappings, N<node>=<pages> in numa_maps
+    std::ifstream maps("/proc/self/numa_maps");
+    vec<size_t> node_bytes;
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        size_t page_kb = 4;
+        const size_t ps = line.find("kernelpagesize_kB=");
+        if (ps != std::string::npos)
+            page_kb = std::stoul(line.substr(ps + 18));
+
+        std::istringstream ss(line);
+        std::string token;
+        while (ss >> token)
+        {
+            if (token.size() < 3 || token[0] != 'N' || !std::isdigit((unsigned char)token[1]))
+                continue;
+            const size_t eq = token.find('=');
+            if (eq == std::string::npos)
+                continue;
+
+            const size_t node = std::stoul(token.substr(1, eq - 1));
+            if (node_bytes.size() <= node)
+                node_bytes.resize(node + 1, 0);
+            node_bytes[node] += std::stoul(token.substr(eq + 1)) * page_kb * 1024;
+        }
+    }
+
+    os << "Resident memory per node:";
+    if (node_bytes.empty())
+        os << " unavailable";
+    for (size_t n = 0; n < node_bytes.size(); ++n)
+        os << " N" << n << "=" << node_bytes[n] / (1024 * 1024) << " MB";
+    os << std::endl;
+
+    // Transparent huge pages actually granted
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    while (std::getline(rollup, line))
+    {
+        if (line.starts_with("AnonHugePages:"))
+            os << "Transparent huge pages: " << std::stoul(line.substr(14)) / 1024 << " MB" << std::endl;
+    }
+
+    const memory_stats stats = get_memory_stats();
+    os << "Allocator: " << stats.allocations << " allocations, " << stats.mapped_bytes / 1024 << " KB mapped ("
+       << stats.hugetlb_bytes / 1024 << " KB hugetlb), " << stats.heap_bytes / 1024 << " KB heap" << std::endl;
+}
@@ -0,0 +1,238 @@
+#include "train/autotune.hpp"
+#include "train/snapshot.hpp"
+
+#include <chrono>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+std::string cpu_model()
+{
+    std::string model = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.starts_with("model name"))
+        {
+            // "model name\t: Name", the value may be missing or blank
+            const size_t colon = line.find(':');
+            const size_t start = colon == std::string::npos ? colon : line.find_first_not_of(" \t", colon + 1);
+            if (start != std::string::npos)
+                model = line.substr(start);
+            break;
+        }
+    }
+
+    return model + " x" + std::to_string(std::thread::hardware_concurrency());
+}
+
+// A cached number, false unless value is all digits and fits
+static bool parse_cached(const std::string& value, size_t& out)
+{
+    const char* end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, out);
+    return ec == std::errc() && ptr == end;
+}
+
+tuning_cache::tuning_cache(std::string path_) : path(std::move(path_))
+{
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream ss(line);
+        std::string cpu, key, value;
+        if (std::getline(ss, cpu, '\t') && std::getline(ss, key, '\t') && std::getline(ss, value))
+            entries[{cpu, key}] = value;
+    }
+}
+
+bool tuning_cache::get(const std::string& cpu, const std::string& key, std::string& value) const
+{
+    auto it = entries.find({cpu, key});
+    if (it == entries.end())
+        return false;
+
+    value = it->second;
+    return true;
+}
+
+void tuning_cache::set(const std::string& cpu, const std::string& key, const std::string& value)
+{
+    entries[{cpu, key}] = value;
+}
+
+void tuning_cache::save() const
+{
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Failed to write tuning cache: " + tmp_path);
+
+        for (auto& [key, value] : entries)
+            file << key.first << '\t' << key.second << '\t' << value << '\n';
+    }
+
+    fs::rename(tmp_path, path);
+}
+
+template <typename F>
+static double time_best(size_t repeats, F&& run)
+{
+    double best = INFINITY;
+    for (size_t r = 0; r < std::max<size_t>(repeats, 1); ++r)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return best;
+}
+
+// Forward and backward through one layer for every captured input
+static void run_layer(basic_layer* layer, const vec<vec<float>>& inputs, dataset_config_t config)
+{
+    layer->begin_updates();
+    for (const auto& x : inputs)
+    {
+        vec<float> out = layer->forward(x);
+        layer->backprop(out, config);
+    }
+    layer->end_updates();
+}
+
+autotune_result autotune(NeuralNetwork& nn, const dataset_view& dataset, const autotune_config_t& cfg)
+{
+    autotune_result result;
+    result.num_batches = dataset.config.num_batches;
+    if (dataset.size == 0)
+        return result;
+
+    const std::string cpu = cpu_model();
+    tuning_cache cache(cfg.cache_path);
+    const vec<basic_layer *>& layers = nn.get_layers();
+
+    // Benchmarks train for real, put the parameters back when done
+    param_snapshot saved;
+    save_params(nn, saved);
+
+    // Inputs every layer sees on real samples, captured on the inference path
+    vec<vec<vec<float>>> inputs(layers.size());
+    const size_t num_samples = std::min(cfg.samples, dataset.size);
+    for (size_t s = 0; s < num_samples; ++s)
+    {
+        vec<float> x = dataset[s].first;
+        for (size_t l = 0; l < layers.size(); ++l)
+        {
+            vec<float> out(layers[l]->get_size() ? layers[l]->get_size() : x.size());
+            layers[l]->forward_into(x.data(), x.size(), out.data());
+            inputs[l].push_back(std::move(x));
+            x = std::move(out);
+        }
+    }
+
+    // One benchmark per distinct shape, shared by every layer that has it
+    std::map<std::string, size_t> winners;
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        basic_layer* layer = layers[l];
+        const std::string key = layer->tuning_key();
+        if (key.empty() || layer->num_variants() < 2)
+            continue;
+
+        if (!winners.contains(key))
+        {
+            // Unreadable or out-of-range entries are retuned like misses
+            std::string value;
+            size_t variant = 0;
+            if (!cfg.force && cache.get(cpu, key, value) && parse_cached(value, variant) &&
+                variant < layer->num_variants())
+            {
+                winners[key] = variant;
+                ++result.cached;
+            }
+            else
+            {
+                const size_t original = layer->get_variant();
+                size_t best = original;
+                double best_time = INFINITY;
+                for (size_t v = 0; v < layer->num_variants(); ++v)
+                {
+                    layer->set_variant(v);
+                    const double t = time_best(cfg.repeats, [&] { run_layer(layer, inputs[l], dataset.config); });
+                    if (t < best_time)
+                    {
+                        best_time = t;
+                        best = v;
+                    }
+                }
+
+                layer->set_variant(original);
+                winners[key] = best;
+                cache.set(cpu, key, std::to_string(best));
+                ++result.tuned;
+            }
+        }
+
+        layer->set_variant(winners[key]);
+    }
+
+    // num_batches depends on the whole network and the core count
+    std::string net_key = "num_batches in" + std::to_string(dataset[0].first.size());
+    for (auto& layer : layers)
+        net_key += " " + (layer->tuning_key().empty() ? std::to_string(layer->get_size()) : layer->tuning_key());
+
+    std::string value;
+    size_t num_batches = 0;
+    if (!cfg.force && cache.get(cpu, net_key, value) && parse_cached(value, num_batches) &&
+        num_batches >= 1 && num_batches <= std::numeric_limits<ushort>::max())
+    {
+        result.num_batches = num_batches;
+        ++result.cached;
+    }
+    else
+    {
+        vec<ushort> candidates = cfg.batch_candidates;
+        if (candidates.empty())
+        {
+            const size_t max_threads = 4 * std::max(1u, std::thread::hardware_concurrency());
+            for (size_t b = 1; b <= max_threads; b *= 2)
+                candidates.push_back(b);
+        }
+
+        // Thread start-up only amortizes over a real epoch slice, use more samples here
+        std::mt19937 gen(0);
+        dataset_view subset = random_split(dataset, std::min(1.0f, 16.0f * cfg.samples / dataset.size), gen).first;
+
+        double best_rate = 0.0;
+        for (ushort b : candidates)
+        {
+            subset.config.num_batches = b;
+            const double t = time_best(cfg.repeats, [&] { nn.backprop(subset); });
+            const double rate = subset.size / t;
+            if (rate > best_rate)
+            {
+                best_rate = rate;
+                result.num_batches = b;
+            }
+        }
+
+        cache.set(cpu, net_key, std::to_string(result.num_batches));
+        ++result.tuned;
+    }
+
+    load_params(nn, saved);
+
+    if (result.tuned)
+        cache.save();
+
+    return result;
+}
@@ -0,0 +1,281 @@
+#include "train/checkpoint.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// File layout: magic, step, buffer count, then per buffer its length and
+// floats, then an FNV-1a hash of everything before it
+static const char CHECKPOINT_MAGIC[8] = { 'N', 'N', 'C', 'K', 'P', 'T', '0', '1' };
+
+static uint64_t fnv1a(const void* data, size_t n, uint64_t h = 1469598103934665603ull)
+{
+    const uint8_t* p = (const uint8_t *)data;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+static std::string checkpoint_name(uint64_t step)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "ckpt-%010llu.bin", (unsigned long long)step);
+    return buf;
+}
+
+// Checkpoint files in dir, oldest first
+static vec<fs::path> list_checkpoints(const std::string& dir)
+{
+    vec<fs::path> files;
+    std::error_code ec;
+    for (auto& entry : fs::directory_iterator(dir, ec))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.starts_with("ckpt-") && name.ends_with(".bin"))
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+checkpointer::checkpointer(checkpoint_config_t cfg) : cfg(cfg)
+{
+    fs::create_directories(cfg.dir);
+    writer = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+checkpointer::~checkpointer()
+{
+    flush();
+}
+
+void checkpointer::save(const NeuralNetwork& nn, uint64_t step)
+{
+    const auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        save_params(nn, pending);
+        pending.version = step;
+        has_pending = true;
+    }
+    cv.notify_one();
+
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stall_total_us += us;
+    stall_max_us = std::max(stall_max_us, us);
+    ++saves;
+}
+
+void checkpointer::flush()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    idle.wait(lock, [&] { return !has_pending && !busy; });
+}
+
+void checkpointer::run(std::stop_token stop)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, stop, [&] { return has_pending; });
+            if (!has_pending)
+                return;
+
+            // take the pending snapshot, its buffers come back for the next save()
+            std::swap(pending, writing);
+            has_pending = false;
+            busy = true;
+        }
+
+        try
+        {
+            write(writing);
+            rotate();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Checkpoint " << writing.version << " failed: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            busy = false;
+        }
+        idle.notify_all();
+    }
+}
+
+void checkpointer::write(const param_snapshot& snap)
+{
+    const fs::path final_path = fs::path(cfg.dir) / checkpoint_name(snap.version);
+    const fs::path tmp_path = final_path.string() + ".tmp";
+
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + tmp_path.string() + ": " + std::strerror(errno));
+
+    // Close the descriptor and drop the partial file before reporting errno
+    auto fail = [&](const std::string& what)
+    {
+        const int err = errno;
+        ::close(fd);
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw std::runtime_error(what + " failed: " + std::strerror(err));
+    };
+
+    uint64_t hash = fnv1a(nullptr, 0);
+    const auto start = std::chrono::steady_clock::now();
+    size_t written = 0;
+
+    // Write in blocks, sleeping whenever we get ahead of the rate limit
+    auto put = [&](const void* data, size_t n)
+    {
+        hash = fnv1a(data, n, hash);
+        const char* p = (const char *)data;
+        while (n > 0)
+        {
+            const size_t block = std::min<size_t>(n, 1 << 20);
+            const ssize_t w = ::write(fd, p, block);
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                fail("write");
+            }
+            p += w;
+            n -= w;
+            written += w;
+
+            if (cfg.max_bytes_per_sec)
+            {
+                const auto due = start + std::chrono::duration<double>((double)written / cfg.max_bytes_per_sec);
+                std::this_thread::sleep_until(due);
+            }
+        }
+    };
+
+    const uint64_t step = snap.version;
+    const uint64_t count = snap.buffers.size();
+    put(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put(&step, sizeof(step));
+    put(&count, sizeof(count));
+    for (auto& buf : snap.buffers)
+    {
+        const uint64_t n = buf.size();
+        put(&n, sizeof(n));
+        put(buf.data(), n * sizeof(float));
+    }
+    const uint64_t digest = hash;
+    put(&digest, sizeof(digest));
+
+    if (::fsync(fd) < 0)
+        fail("fsync");
+    if (::close(fd) < 0)
+    {
+        const int err = errno;
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw std::runtime_error("close failed: " + std::string(std::strerror(err)));
+    }
+
+    // Publish atomically, then make the rename itself durable
+    fs::rename(tmp_path, final_path);
+    const int dir_fd = ::open(cfg.dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0)
+    {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+}
+
+void checkpointer::rotate()
+{
+    vec<fs::path> files = list_checkpoints(cfg.dir);
+    for (size_t i = 0; i + cfg.keep < files.size(); ++i)
+        fs::remove(files[i]);
+}
+
+// Read a checkpoint into snap, false if it is truncated or corrupt. Every
+// length is checked against the bytes left in the file before allocating.
+static bool read_checkpoint(const fs::path& path, param_snapshot& snap)
+{
+    std::error_code ec;
+    const uint64_t file_size = fs::file_size(path, ec);
+    if (ec)
+        return false;
+
+    std::ifstream file(path, std::ios::binary);
+    uint64_t hash = fnv1a(nullptr, 0);
+    uint64_t remaining = file_size;
+    auto get = [&](void* data, size_t n)
+    {
+        file.read((char *)data, n);
+        hash = fnv1a(data, n, hash);
+        remaining -= std::min<uint64_t>(remaining, n);
+        return (bool)file;
+    };
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint64_t step = 0, count = 0;
+    if (!get(magic, sizeof(magic)) || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+        !get(&step, sizeof(step)) || !get(&count, sizeof(count)))
+        return false;
+
+    // each buffer takes at least its length, and the digest follows them
+    const uint64_t digest_size = sizeof(uint64_t);
+    if (remaining < digest_size || count > (remaining - digest_size) / sizeof(uint64_t))
+        return false;
+
+    snap.buffers.resize(count);
+    for (auto& buf : snap.buffers)
+    {
+        uint64_t n = 0;
+        if (!get(&n, sizeof(n)) || remaining < digest_size || n > (remaining - digest_size) / sizeof(float))
+            return false;
+        buf.resize(n);
+        if (!get(buf.data(), n * sizeof(float)))
+            return false;
+    }
+
+    const uint64_t expected = hash;
+    uint64_t digest = 0;
+    file.read((char *)&digest, sizeof(digest));
+    if (!file || digest != expected)
+        return false;
+
+    snap.version = step;
+    return true;
+}
+
+std::optional<uint64_t> checkpointer::resume(NeuralNetwork& nn, const std::string& dir)
+{
+    vec<fs::path> files = list_checkpoints(dir);
+    for (auto it = files.rbegin(); it != files.rend(); ++it)
+    {
+        param_snapshot snap;
+        if (!read_checkpoint(*it, snap))
+        {
+            std::cerr << "Skipping damaged checkpoint " << it->string() << std::endl;
+            continue;
+        }
+
+        if (!matches_topology(nn, snap))
+        {
+            std::cerr << "Skipping checkpoint " << it->string() << ": it does not match the network topology" << std::endl;
+            continue;
+        }
+
+        load_params(nn, snap);
+        return snap.version;
+    }
+
+    return std::nullopt;
+}
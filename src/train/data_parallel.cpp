@@ -0,0 +1,164 @@
+#include "train/data_parallel.hpp"
+#include "numa_memory.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <sched.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <sys/wait.h>
+
+data_parallel_trainer::data_parallel_trainer(NeuralNetwork& nn, ring_allreduce& ring, size_t step_size)
+    : nn(nn), ring(ring)
+{
+    const size_t world = ring.get_world();
+    local_step = std::max<size_t>(1, (step_size + world - 1) / world);
+}
+
+float data_parallel_trainer::train_epoch(const dataset_view& shard)
+{
+    const int world = ring.get_world();
+
+    // A single rank is exactly sequential training, keep it bit-identical
+    if (world <= 1)
+        return shard.size ? nn.train_range(shard, 0, shard.size) / shard.size : 0.0f;
+
+    // Every rank has to run the same number of all-reduce calls, so agree on
+    // the largest shard first (shards differ by at most one sample)
+    vec<float> sizes(world, 0.0f);
+    sizes[ring.get_rank()] = (float)shard.size;
+    ring.allreduce(sizes);
+
+    const size_t max_shard = *std::max_element(sizes.begin(), sizes.end());
+    const size_t steps = (max_shard + local_step - 1) / local_step;
+
+    vec<std::span<float>> params = nn.get_params();
+    size_t num_params = 0;
+    for (auto& p : params)
+        num_params += p.size();
+
+    base.resize(num_params);
+    delta.resize(num_params + 2); // + loss sum and sample count
+
+    float loss_sum = 0.0f;
+    float sample_count = 0.0f;
+
+    for (size_t s = 0; s < steps; ++s)
+    {
+        const size_t start = std::min(s * local_step, shard.size);
+        const size_t end = std::min(start + local_step, shard.size);
+
+        size_t off = 0;
+        for (auto& p : params)
+        {
+            std::copy(p.begin(), p.end(), base.begin() + off);
+            off += p.size();
+        }
+
+        const float loss = nn.train_range(shard, start, end);
+
+        off = 0;
+        for (auto& p : params)
+        {
+            for (size_t i = 0; i < p.size(); ++i)
+                delta[off + i] = p[i] - base[off + i];
+            off += p.size();
+        }
+        delta[num_params] = loss;
+        delta[num_params + 1] = (float)(end - start);
+
+        ring.allreduce(delta);
+
+        off = 0;
+        for (auto& p : params)
+        {
+            for (size_t i = 0; i < p.size(); ++i)
+                p[i] = base[off + i] + delta[off + i];
+            off += p.size();
+        }
+        nn.mark_weights_changed();
+        loss_sum += delta[num_params];
+        sample_count += delta[num_params + 1];
+    }
+
+    return sample_count > 0 ? loss_sum / sample_count : 0.0f;
+}
+
+int launch_data_parallel(int world, const std::function<int(int, int)>& fn, bool pin_numa)
+{
+    const vec<vec<int>> nodes = pin_numa ? numa_nodes() : vec<vec<int>>{};
+
+    // Terminate and reap every rank still running
+    vec<pid_t> children;
+    auto stop_all = [&]()
+    {
+        for (pid_t pid : children)
+            ::kill(pid, SIGTERM);
+        for (pid_t pid : children)
+            ::waitpid(pid, nullptr, 0);
+        children.clear();
+    };
+
+    for (int rank = 0; rank < world; ++rank)
+    {
+        pid_t pid = ::fork();
+        if (pid < 0)
+        {
+            std::cerr << "launch_data_parallel: fork failed, stopping " << children.size() << " started ranks" << std::endl;
+            stop_all();
+            return 1;
+        }
+
+        if (pid == 0)
+        {
+            if (!nodes.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int cpu : nodes[rank % nodes.size()])
+                    CPU_SET(cpu, &set);
+                ::sched_setaffinity(0, sizeof(set), &set);
+            }
+
+            int code = 1;
+            try
+            {
+                code = fn(rank, world);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Rank " << rank << ": " << e.what() << std::endl;
+            }
+
+            std::cout.flush();
+            ::_exit(code);
+        }
+
+        children.push_back(pid);
+    }
+
+    // The ranks depend on each other, once one fails the rest cannot finish
+    while (!children.empty())
+    {
+        int status = 0;
+        const pid_t pid = ::waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        std::erase(children, pid);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "launch_data_parallel: a rank failed, stopping the other " << children.size() << std::endl;
+            stop_all();
+            return 1;
+        }
+    }
+
+    return 0;
+}
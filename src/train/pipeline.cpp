@@ -0,0 +1,204 @@
+#include "train/pipeline.hpp"
+#include <deque>
+#include <pthread.h>
+
+pipeline_executor::pipeline_executor(NeuralNetwork& nn, pipeline_config_t cfg)
+    : nn(nn), cfg(cfg)
+{
+    const vec<basic_layer *>& layers = nn.get_layers();
+    this->cfg.stages = std::clamp<size_t>(cfg.stages, 1, std::max<size_t>(1, layers.size()));
+    this->cfg.micro_batch = std::max<size_t>(1, cfg.micro_batch);
+    const size_t S = this->cfg.stages;
+
+    // Balance stages by parameter count plus output width, a rough proxy for
+    // the work of a layer's forward and backward pass
+    vec<size_t> cost(layers.size());
+    size_t total = 0;
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        vec<std::span<const float>> params = layers[l]->view_params();
+        cost[l] = layers[l]->get_size();
+        for (auto& p : params)
+            cost[l] += p.size();
+        total += cost[l];
+    }
+
+    bounds = { 0 };
+    size_t acc = 0;
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        acc += cost[l];
+        const size_t remaining_layers = layers.size() - l - 1;
+        const size_t remaining_stages = S - bounds.size();
+        if (bounds.size() < S && remaining_layers > 0 &&
+            (acc * S >= total * bounds.size() || remaining_layers == remaining_stages))
+            bounds.push_back(l + 1);
+    }
+    bounds.push_back(layers.size());
+
+    // In-flight micro-batches per stage never exceed the stage count, so this
+    // depth keeps the forward and backward queues from ever filling up
+    const size_t depth = std::max(this->cfg.queue_depth, S + 1);
+    for (size_t s = 0; s + 1 < S; ++s)
+    {
+        fwd.push_back(std::make_unique<spsc_queue<message>>(depth));
+        bwd.push_back(std::make_unique<spsc_queue<message>>(depth));
+    }
+}
+
+vec<float> pipeline_executor::forward_range(size_t s, vec<float> x)
+{
+    const vec<basic_layer *>& layers = nn.get_layers();
+    for (size_t l = bounds[s]; l < bounds[s + 1]; ++l)
+        x = layers[l]->forward(x);
+
+    return x;
+}
+
+vec<float> pipeline_executor::backward_range(size_t s, vec<float> grad, dataset_config_t config)
+{
+    const vec<basic_layer *>& layers = nn.get_layers();
+    for (size_t l = bounds[s + 1]; l-- > bounds[s]; )
+        grad = layers[l]->backprop(grad, config);
+
+    return grad;
+}
+
+void pipeline_executor::stage_loop(size_t s, size_t num_micro, const dataset_view* train,
+                                   const vec<vec<float>>* inputs, vec<vec<float>>* outputs, float* loss)
+{
+    const size_t S = cfg.stages;
+    const bool first = s == 0;
+    const bool last = s + 1 == S;
+    const bool training = train != nullptr;
+    const size_t limit = training ? S - s : SIZE_MAX;
+    const size_t num_samples = training ? train->size : inputs->size();
+
+    std::deque<vec<vec<float>>> stash; // stage inputs of in-flight micro-batches, oldest first
+    size_t fwd_done = 0;
+    size_t bwd_done = 0;
+    float stage_loss = 0.0f;
+
+    while (training ? bwd_done < num_micro : fwd_done < num_micro)
+    {
+        message msg;
+
+        // Backward first, it frees an in-flight slot and unblocks upstream
+        if (training && !last && bwd[s]->try_pop(msg))
+        {
+            vec<vec<float>> x = std::move(stash.front());
+            stash.pop_front();
+
+            for (size_t j = 0; j < msg.data.size(); ++j)
+            {
+                forward_range(s, x[j]); // restore this sample's layer caches
+                msg.data[j] = backward_range(s, std::move(msg.data[j]), train->config);
+            }
+
+            if (!first)
+                bwd[s - 1]->push(std::move(msg));
+            ++bwd_done;
+            continue;
+        }
+
+        if (fwd_done >= num_micro || fwd_done - bwd_done >= limit)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (first)
+        {
+            const size_t start = fwd_done * cfg.micro_batch;
+            const size_t end = std::min(start + cfg.micro_batch, num_samples);
+            msg.id = fwd_done;
+            for (size_t i = start; i < end; ++i)
+                msg.data.push_back(training ? (*train)[i].first : (*inputs)[i]);
+        }
+        else if (!fwd[s - 1]->try_pop(msg))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (last && training)
+        {
+            // Turn around immediately: forward, loss and backward per sample
+            const loss_function& loss_fn = nn.get_loss_function();
+            const size_t start = msg.id * cfg.micro_batch;
+            for (size_t j = 0; j < msg.data.size(); ++j)
+            {
+                const vec<float>& Y = (*train)[start + j].second;
+                vec<float> grad = forward_range(s, std::move(msg.data[j]));
+                stage_loss += loss_fn(grad, Y);
+                msg.data[j] = backward_range(s, std::move(grad), train->config);
+            }
+
+            if (!first)
+                bwd[s - 1]->push(std::move(msg));
+            ++fwd_done;
+            ++bwd_done;
+            continue;
+        }
+
+        if (training)
+            stash.push_back(msg.data);
+
+        for (auto& x : msg.data)
+            x = forward_range(s, std::move(x));
+
+        if (last)
+        {
+            const size_t start = msg.id * cfg.micro_batch;
+            for (size_t j = 0; j < msg.data.size(); ++j)
+                (*outputs)[start + j] = std::move(msg.data[j]);
+        }
+        else
+            fwd[s]->push(std::move(msg));
+
+        ++fwd_done;
+    }
+
+    if (last && loss)
+        *loss = stage_loss;
+}
+
+void pipeline_executor::run(size_t num_samples, const dataset_view* train, const vec<vec<float>>* inputs,
+                            vec<vec<float>>* outputs, float* loss)
+{
+    const size_t num_micro = (num_samples + cfg.micro_batch - 1) / cfg.micro_batch;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    vec<std::thread> workers;
+    for (size_t s = 0; s < cfg.stages; ++s)
+    {
+        workers.emplace_back(&pipeline_executor::stage_loop, this, s, num_micro, train, inputs, outputs, loss);
+
+        if (cfg.pin)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(s % cores, &set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+        }
+    }
+
+    for (auto& w : workers)
+        w.join();
+}
+
+float pipeline_executor::train(const dataset_view& dataset)
+{
+    float loss = 0.0f;
+    nn.begin_training();
+    run(dataset.size, &dataset, nullptr, nullptr, &loss);
+    nn.end_training();
+    return dataset.size ? loss / dataset.size : 0.0f;
+}
+
+vec<vec<float>> pipeline_executor::infer(const vec<vec<float>>& inputs)
+{
+    vec<vec<float>> outputs(inputs.size());
+    run(inputs.size(), nullptr, &inputs, &outputs, nullptr);
+    return outputs;
+}
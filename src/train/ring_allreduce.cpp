@@ -0,0 +1,203 @@
+#include "train/ring_allreduce.hpp"
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// How long a rank waits for its neighbours to show up before giving up, so a
+// rank that died during setup fails the others instead of hanging them
+#define RING_CONNECT_TIMEOUT_MS 30000
+
+static sockaddr_un make_addr(const std::string& path, int rank)
+{
+    const std::string name = path + "." + std::to_string(rank);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (name.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Socket path too long: " + name);
+    std::strncpy(addr.sun_path, name.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+ring_allreduce::ring_allreduce(const std::string& path, int rank, int world)
+    : rank(rank), world(world), path(path)
+{
+    if (world <= 1)
+        return;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(RING_CONNECT_TIMEOUT_MS);
+
+    // Listen first so the previous rank can queue its connection before we accept
+    sockaddr_un self = make_addr(path, rank);
+    ::unlink(self.sun_path);
+
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    auto fail = [&](const std::string& what)
+    {
+        const std::string error = std::strerror(errno);
+        if (listen_fd >= 0)
+        {
+            ::close(listen_fd);
+            ::unlink(self.sun_path);
+        }
+        if (send_fd >= 0)
+            ::close(send_fd);
+        send_fd = -1;
+        throw std::runtime_error("ring_allreduce: " + what + ": " + error);
+    };
+
+    if (listen_fd < 0 ||
+        ::bind(listen_fd, (sockaddr *)&self, sizeof(self)) < 0 ||
+        ::listen(listen_fd, 1) < 0)
+        fail("listen failed");
+
+    // Connect to the next rank, which may not have started listening yet
+    sockaddr_un next = make_addr(path, (rank + 1) % world);
+    send_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (send_fd < 0)
+        fail("socket failed");
+    while (::connect(send_fd, (sockaddr *)&next, sizeof(next)) < 0)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            fail("connect to rank " + std::to_string((rank + 1) % world) + " timed out");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Wait for the previous rank's connection, no longer than the deadline
+    for (;;)
+    {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd pfd = { listen_fd, POLLIN, 0 };
+        const int ready = ::poll(&pfd, 1, std::max<int>(0, left.count()));
+        if (ready > 0)
+            break;
+        if (ready == 0)
+        {
+            errno = ETIMEDOUT;
+            fail("accept from rank " + std::to_string((rank + world - 1) % world) + " timed out");
+        }
+        if (errno != EINTR)
+            fail("poll failed");
+    }
+
+    recv_fd = ::accept(listen_fd, nullptr, nullptr);
+    if (recv_fd < 0)
+        fail("accept failed");
+    ::close(listen_fd);
+    ::unlink(self.sun_path);
+
+    ::fcntl(send_fd, F_SETFL, ::fcntl(send_fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(recv_fd, F_SETFL, ::fcntl(recv_fd, F_GETFL) | O_NONBLOCK);
+}
+
+ring_allreduce::~ring_allreduce()
+{
+    if (send_fd >= 0)
+        ::close(send_fd);
+    if (recv_fd >= 0)
+        ::close(recv_fd);
+}
+
+// Send to the next rank and receive from the previous one at the same time.
+// Doing both in one poll loop keeps large chunks from deadlocking the ring
+// when every rank would otherwise block in send() first.
+void ring_allreduce::exchange(const float* send, size_t send_n, float* recv, size_t recv_n)
+{
+    const char* out = (const char *)send;
+    char* in = (char *)recv;
+    size_t out_left = send_n * sizeof(float);
+    size_t in_left = recv_n * sizeof(float);
+
+    while (out_left > 0 || in_left > 0)
+    {
+        pollfd fds[2] = {
+            { send_fd, (short)(out_left > 0 ? POLLOUT : 0), 0 },
+            { recv_fd, (short)(in_left  > 0 ? POLLIN  : 0), 0 }
+        };
+
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("ring_allreduce: poll failed: ") + std::strerror(errno));
+        }
+
+        if (out_left > 0 && (fds[0].revents & (POLLOUT | POLLERR | POLLHUP)))
+        {
+            ssize_t n = ::send(send_fd, out, out_left, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                throw std::runtime_error(std::string("ring_allreduce: send failed: ") + std::strerror(errno));
+            if (n > 0)
+            {
+                out += n;
+                out_left -= n;
+            }
+        }
+
+        if (in_left > 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP)))
+        {
+            ssize_t n = ::recv(recv_fd, in, in_left, 0);
+            if (n == 0)
+                throw std::runtime_error("ring_allreduce: peer closed connection");
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                throw std::runtime_error(std::string("ring_allreduce: recv failed: ") + std::strerror(errno));
+            if (n > 0)
+            {
+                in += n;
+                in_left -= n;
+            }
+        }
+    }
+}
+
+void ring_allreduce::allreduce(std::span<float> data)
+{
+    if (world <= 1)
+        return;
+
+    const size_t n = data.size();
+    auto chunk_begin = [&](int c) { return (size_t)c * n / world; };
+    auto chunk_size  = [&](int c) { return chunk_begin(c + 1) - chunk_begin(c); };
+
+    scratch.resize(n / world + 1);
+
+    // Reduce-scatter: after world-1 steps rank r owns the full sum of chunk r+1
+    for (int s = 0; s < world - 1; ++s)
+    {
+        const int send_c = (rank - s + world) % world;
+        const int recv_c = (rank - s - 1 + world) % world;
+
+        exchange(data.data() + chunk_begin(send_c), chunk_size(send_c),
+                 scratch.data(), chunk_size(recv_c));
+
+        float* dst = data.data() + chunk_begin(recv_c);
+        for (size_t i = 0; i < chunk_size(recv_c); ++i)
+            dst[i] += scratch[i];
+    }
+
+    // All-gather: circulate the reduced chunks so every rank holds all of them
+    for (int s = 0; s < world - 1; ++s)
+    {
+        const int send_c = (rank + 1 - s + world) % world;
+        const int recv_c = (rank - s + world) % world;
+
+        exchange(data.data() + chunk_begin(send_c), chunk_size(send_c),
+                 data.data() + chunk_begin(recv_c), chunk_size(recv_c));
+    }
+}
+
+void ring_allreduce::barrier()
+{
+    // One element per rank so every link in the ring carries data
+    vec<float> token(world, 0.0f);
+    allreduce(token);
+}
@@ -0,0 +1,131 @@
+#include "train/snapshot.hpp"
+#include <stdexcept>
+
+// Everything a snapshot holds: the parameters, then the state buffers
+static vec<std::span<const float>> snapshot_spans(const NeuralNetwork& nn)
+{
+    vec<std::span<const float>> spans = nn.view_params();
+    vec<std::span<const float>> buffers = nn.view_buffers();
+    spans.insert(spans.end(), buffers.begin(), buffers.end());
+    return spans;
+}
+
+void save_params(const NeuralNetwork& nn, param_snapshot& snap)
+{
+    vec<std::span<const float>> spans = snapshot_spans(nn);
+    snap.buffers.resize(spans.size());
+    for (size_t i = 0; i < spans.size(); ++i)
+        snap.buffers[i].assign(spans[i].begin(), spans[i].end());
+}
+
+bool matches_topology(const NeuralNetwork& nn, const param_snapshot& snap)
+{
+    vec<std::span<const float>> spans = snapshot_spans(nn);
+    if (spans.size() != snap.buffers.size())
+        return false;
+
+    for (size_t i = 0; i < spans.size(); ++i)
+    {
+        if (spans[i].size() != snap.buffers[i].size())
+            return false;
+    }
+
+    return true;
+}
+
+void load_params(NeuralNetwork& nn, const param_snapshot& snap)
+{
+    if (!matches_topology(nn, snap))
+        throw std::runtime_error("load_params: snapshot does not match the network topology");
+
+    vec<std::span<float>> spans = nn.get_params();
+    vec<std::span<float>> buffers = nn.get_buffers();
+    spans.insert(spans.end(), buffers.begin(), buffers.end());
+    for (size_t i = 0; i < spans.size(); ++i)
+        std::copy(snap.buffers[i].begin(), snap.buffers[i].end(), spans[i].begin());
+    nn.mark_weights_changed();
+}
+
+void snapshot_channel::publish(const NeuralNetwork& nn)
+{
+    // Reuse the spare buffer if no reader still holds it, otherwise leave it
+    // to the readers and allocate a fresh one
+    std::shared_ptr<param_snapshot> next = spare;
+    if (!next || next.use_count() != 1)
+        next = std::make_shared<param_snapshot>();
+
+    save_params(nn, *next);
+    next->version = ++version;
+
+    std::shared_ptr<const param_snapshot> prev = latest.exchange(next, std::memory_order_acq_rel);
+    spare = std::const_pointer_cast<param_snapshot>(prev);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+    }
+    cv.notify_all();
+}
+
+std::shared_ptr<const param_snapshot> snapshot_channel::wait_newer(uint64_t seen, std::stop_token stop)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, stop, [&] {
+        auto snap = get();
+        return snap && snap->version > seen;
+    });
+
+    return stop.stop_requested() ? nullptr : get();
+}
+
+bool snapshot_channel::refresh(NeuralNetwork& nn, uint64_t& loaded)
+{
+    std::shared_ptr<const param_snapshot> snap = get();
+    if (!snap || snap->version <= loaded)
+        return false;
+
+    load_params(nn, *snap);
+    loaded = snap->version;
+    return true;
+}
+
+async_validator::async_validator(NeuralNetwork& eval_nn, snapshot_channel& channel, const dataset_view& validation,
+                                 std::function<void(uint64_t, float)> on_result)
+    : eval_nn(eval_nn), channel(channel), validation(validation), on_result(std::move(on_result))
+{
+    worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+async_validator::~async_validator()
+{
+    worker.request_stop();
+}
+
+void async_validator::run(std::stop_token stop)
+{
+    uint64_t seen = 0;
+    while (!stop.stop_requested())
+    {
+        std::shared_ptr<const param_snapshot> snap = channel.wait_newer(seen, stop);
+        if (!snap)
+            break;
+
+        // Skipped versions are fine, we always score the newest one
+        load_params(eval_nn, *snap);
+        seen = snap->version;
+        snap.reset();
+
+        const float accuracy = eval_nn.test(validation);
+        last_accuracy.store(accuracy);
+        last_version.store(seen);
+        last_version.notify_all();
+
+        if (on_result)
+            on_result(seen, accuracy);
+    }
+}
+
+void async_validator::wait_for(uint64_t version)
+{
+    for (uint64_t v = last_version.load(); v < version; v = last_version.load())
+        last_version.wait(v);
+}
@@ -0,0 +1,151 @@
+#include "train/sweep.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <numeric>
+#include <algorithm>
+#include "layers/normalization_layer.hpp"
+#include "layers/activation_layer.hpp"
+#include "layers/dense_layer.hpp"
+
+std::unique_ptr<NeuralNetwork> build_trial_model(const sweep_trial_t& trial, size_t input_size, size_t output_size,
+                                                 std::optional<uint32_t> seed)
+{
+    vec<basic_layer *> layers = {
+        new normalization_layer(input_size),
+        new activation_layer(input_size, trial.activation)
+    };
+    for (size_t width : trial.widths)
+        layers.push_back(new dense_layer(width, trial.activation));
+    layers.push_back(new dense_layer(output_size, "softmax"));
+
+    return std::make_unique<NeuralNetwork>(layers, trial.loss, seed);
+}
+
+// Run fn(0 .. n - 1) on up to `threads` threads, each taking the next index
+template <typename F>
+static void parallel_for(size_t n, size_t threads, F&& fn)
+{
+    std::atomic<size_t> next{0};
+    vec<std::jthread> workers;
+    for (size_t t = 0; t < std::min(threads, n); ++t)
+    {
+        workers.emplace_back([&]
+        {
+            for (size_t i = next++; i < n; i = next++)
+                fn(i);
+        });
+    }
+}
+
+vec<sweep_result_t> run_sweep(const dataset_view& dataset, const vec<sweep_trial_t>& trials, const sweep_config_t& cfg)
+{
+    if (dataset.size == 0 || trials.empty())
+        return {};
+
+    std::mt19937 gen(cfg.seed);
+    auto [validation, train] = stratified_split(dataset, cfg.validation_fraction, gen);
+    const size_t input_size = dataset[0].first.size();
+    const size_t output_size = dataset[0].second.size();
+
+    struct trial_state
+    {
+        std::unique_ptr<NeuralNetwork> nn;
+        dataset_view train;
+        sweep_result_t result;
+    };
+
+    vec<trial_state> states(trials.size());
+    for (size_t i = 0; i < trials.size(); ++i)
+    {
+        states[i].nn = build_trial_model(trials[i], input_size, output_size, cfg.seed);
+        states[i].train = train;
+        states[i].train.config.lr = trials[i].lr;
+        states[i].train.config.num_batches = 1; // the pool already keeps every core busy
+        states[i].result.trial = trials[i];
+    }
+
+    const size_t threads = cfg.threads ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+    const size_t eta = std::max<size_t>(cfg.eta, 2);
+
+    vec<size_t> alive(trials.size());
+    std::iota(alive.begin(), alive.end(), 0);
+
+    size_t budget = std::min(std::max<size_t>(cfg.min_epochs, 1), cfg.max_epochs);
+    for (size_t rung = 0; ; ++rung)
+    {
+        // Bring every surviving trial up to this rung's epoch budget
+        parallel_for(alive.size(), threads, [&](size_t k)
+        {
+            trial_state& s = states[alive[k]];
+            const auto start = std::chrono::steady_clock::now();
+
+            while (s.result.epochs < budget)
+            {
+                s.result.loss = s.nn->backprop(s.train);
+                ++s.result.epochs;
+            }
+            s.result.accuracy = s.nn->test(validation);
+            s.result.rung = rung;
+
+            s.result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+
+        if (alive.size() <= 1 || budget >= cfg.max_epochs)
+            break;
+
+        // Keep the best 1 / eta and free the networks of the rest
+        std::stable_sort(alive.begin(), alive.end(), [&](size_t a, size_t b)
+            { return states[a].result.accuracy > states[b].result.accuracy; });
+
+        const size_t keep = std::max<size_t>(1, alive.size() / eta);
+        for (size_t k = keep; k < alive.size(); ++k)
+            states[alive[k]].nn.reset();
+        alive.resize(keep);
+
+        budget = std::min(budget * eta, cfg.max_epochs);
+    }
+
+    for (size_t i : alive)
+        states[i].result.finished = true;
+
+    vec<sweep_result_t> results;
+    for (auto& s : states)
+        results.push_back(std::move(s.result));
+
+    // Trials that got further rank first, then by accuracy
+    std::stable_sort(results.begin(), results.end(), [](const sweep_result_t& a, const sweep_result_t& b)
+    {
+        if (a.rung != b.rung)
+            return a.rung > b.rung;
+        return a.accuracy > b.accuracy;
+    });
+
+    return results;
+}
+
+void write_sweep_table(std::ostream& os, const vec<sweep_result_t>& results)
+{
+    os << std::left << std::setw(6) << "Rank" << std::setw(24) << "Trial" << std::setw(10) << "LR"
+       << std::setw(14) << "Widths" << std::setw(12) << "Activation" << std::right << std::setw(8) << "Epochs"
+       << std::setw(12) << "Loss" << std::setw(12) << "Accuracy" << std::setw(10) << "Seconds" << "  Status" << std::endl;
+
+    for (size_t r = 0; r < results.size(); ++r)
+    {
+        const sweep_result_t& res = results[r];
+
+        std::string widths;
+        for (size_t w : res.trial.widths)
+            widths += (widths.empty() ? "" : "-") + std::to_string(w);
+
+        os << std::left << std::setw(6) << r + 1 << std::setw(24) << res.trial.name
+           << std::setw(10) << std::defaultfloat << res.trial.lr << std::setw(14) << widths
+           << std::setw(12) << res.trial.activation << std::right << std::setw(8) << res.epochs
+           << std::fixed << std::setprecision(4) << std::setw(12) << res.loss
+           << std::setprecision(2) << std::setw(11) << res.accuracy * 100 << '%'
+           << std::setw(10) << res.seconds
+           << "  " << (res.finished ? "finished" : "stopped at rung " + std::to_string(res.rung)) << std::endl;
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal assertions for the test programs: a failed CHECK prints where and
+// what, and the test's main returns the number of failures
+inline int check_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do                                                                               \
+    {                                                                                \
+        if (!(cond))                                                                 \
+        {                                                                            \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed"  \
+                      << std::endl;                                                  \
+            ++check_failures;                                                        \
+        }                                                                            \
+    } while (0)
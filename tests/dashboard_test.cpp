@@ -0,0 +1,105 @@
+// Headless checks of the dashboard: publishing never waits for the render
+// thread, a full ring drops and counts updates, and the render thread drains
+// the ring and stops cleanly.
+
+#include <chrono>
+#include "check.hpp"
+#include "dashboard.hpp"
+#include "layers/dense_layer.hpp"
+
+#define RING_CAPACITY 4
+#define EXTRA_EVENTS 6
+
+// Longest the render thread may take to drain or shut down, many frames
+#define WAIT_LIMIT std::chrono::seconds(5)
+
+// What the test sees of the render thread, outlives the dashboard
+struct render_probe
+{
+    std::atomic<bool> drawing{false};
+    std::atomic<bool> gate_open{false};
+    std::atomic<size_t> loss_points{0};
+    std::atomic<size_t> histograms{0};
+    std::atomic<uint64_t> frames{0};
+};
+
+// null_renderer whose first frame blocks until the test opens the gate, so
+// the ring is not drained while the test fills it
+class gated_renderer : public null_renderer
+{
+    render_probe& probe;
+
+public:
+    gated_renderer(render_probe& probe) : probe(probe) {}
+
+    bool draw(const dashboard_state& state) override
+    {
+        probe.drawing = true;
+        while (!probe.gate_open)
+            std::this_thread::yield();
+
+        probe.loss_points = state.loss.size();
+        probe.histograms = state.histograms.size();
+        probe.frames = get_frames() + 1;
+        return null_renderer::draw(state);
+    }
+};
+
+template <typename Pred>
+static bool wait_until(Pred pred)
+{
+    const auto deadline = std::chrono::steady_clock::now() + WAIT_LIMIT;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+int main()
+{
+    render_probe probe;
+    NeuralNetwork nn({ new dense_layer(8, "relu"), new dense_layer(4, "softmax") }, "cce", 1);
+    nn.forward(vec<float>(16, 0.5f));
+
+    auto view = std::make_unique<dashboard>(std::make_unique<gated_renderer>(probe), RING_CAPACITY);
+    CHECK(wait_until([&] { return probe.drawing.load(); }));
+
+    // The render thread is stuck in draw(), so only RING_CAPACITY events fit.
+    // Reaching the checks below at all means publishing did not wait for it.
+    for (size_t i = 0; i < RING_CAPACITY + EXTRA_EVENTS; ++i)
+        view->publish_metrics(i, 1.0f / (i + 1));
+    CHECK(view->get_dropped() == EXTRA_EVENTS);
+
+    // The first layer has no input width and is not histogrammed, so only
+    // the second layer's weights are dropped
+    view->publish_sample(0, vec<float>(16, 0.0f), 1, 2);
+    view->publish_weights(0, nn);
+    CHECK(view->get_dropped() == EXTRA_EVENTS + 1 + 1);
+
+    // Once drawing resumes the queued metrics reach the state and the ring
+    // has room again
+    probe.gate_open = true;
+    CHECK(wait_until([&] { return probe.loss_points.load() == RING_CAPACITY; }));
+
+    view->publish_weights(1, nn);
+    CHECK(wait_until([&] { return probe.histograms.load() == 1; }));
+    CHECK(view->get_dropped() == EXTRA_EVENTS + 1 + 1);
+
+    // The destructor stops and joins the render thread within a few frames,
+    // and no frame is drawn after it
+    const auto start = std::chrono::steady_clock::now();
+    view.reset();
+    CHECK(std::chrono::steady_clock::now() - start < WAIT_LIMIT);
+
+    const uint64_t frames = probe.frames.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(probe.frames.load() == frames);
+
+    std::cout << "dashboard: " << RING_CAPACITY + EXTRA_EVENTS << " metrics published into a ring of "
+              << RING_CAPACITY << ", " << frames << " frames drawn" << std::endl;
+    return check_failures;
+}
@@ -0,0 +1,146 @@
+// Generator half of the export parity test: trains small networks, exports
+// them with NeuralNetwork::export_header and writes the library's outputs on a
+// fixed set of inputs next to them, for export_test.cpp to compare against.
+
+#include <fstream>
+#include <iostream>
+#include "nn.hpp"
+#include "export.hpp"
+#include "layers/normalization_layer.hpp"
+#include "layers/activation_layer.hpp"
+#include "layers/dense_layer.hpp"
+#include "layers/gating_layer.hpp"
+
+// Not a multiple of the normalization lanes, so the tail merge is covered
+#define INPUT_SIZE 60
+#define OUTPUT_SIZE 4
+#define NUM_CASES 16
+
+static dataset_t make_dataset(std::mt19937& gen)
+{
+    std::normal_distribution<float> noise(0.0f, 0.5f);
+    vec2<float> X, Y;
+    for (size_t i = 0; i < 400; ++i)
+    {
+        vec<float> x(INPUT_SIZE), y(OUTPUT_SIZE, 0.0f);
+        for (auto& v : x)
+            v = noise(gen);
+        x[i % OUTPUT_SIZE] += 2.0f;
+        y[i % OUTPUT_SIZE] = 1.0f;
+        X.push_back(x);
+        Y.push_back(y);
+    }
+
+    dataset_t dataset = create_dataset(X, Y);
+    dataset.config.lr = 0.01f;
+    dataset.config.num_batches = 1;
+    return dataset;
+}
+
+// Samples from the training distribution, inputs with a large common offset
+// (where a naive variance would cancel) and mostly-zero inputs
+static vec2<float> make_cases(const dataset_t& dataset, std::mt19937& gen)
+{
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    vec2<float> cases;
+    for (size_t i = 0; i < NUM_CASES / 2; ++i)
+        cases.push_back(dataset.data[i * 7].first);
+    for (size_t i = 0; i < NUM_CASES / 4; ++i)
+    {
+        vec<float> x(INPUT_SIZE);
+        for (auto& v : x)
+            v = 1000.0f + noise(gen);
+        cases.push_back(x);
+    }
+    for (size_t i = 0; i < NUM_CASES / 4; ++i)
+    {
+        vec<float> x(INPUT_SIZE, 0.0f);
+        for (size_t k = 0; k < 6; ++k)
+            x[(i * 11 + k * 7) % INPUT_SIZE] = 1.0f + noise(gen);
+        cases.push_back(x);
+    }
+
+    return cases;
+}
+
+static void write_array(std::ostream& os, const std::string& name, const vec2<float>& rows)
+{
+    os << "inline constexpr float " << name << "[" << rows.size() << "][" << rows[0].size() << "] = {\n";
+    for (const auto& row : rows)
+    {
+        os << "    {";
+        for (size_t i = 0; i < row.size(); ++i)
+            os << float_literal(row[i]) << (i + 1 < row.size() ? ", " : "");
+        os << "},\n";
+    }
+    os << "};\n\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "usage: export_models <output dir>" << std::endl;
+        return 1;
+    }
+    const std::string dir = argv[1];
+
+    std::mt19937 gen(3);
+    dataset_t dataset = make_dataset(gen);
+    const vec2<float> cases = make_cases(dataset, gen);
+
+    // Layer normalization, compared against forward()
+    NeuralNetwork layer_nn({
+        new normalization_layer(INPUT_SIZE),
+        new activation_layer(INPUT_SIZE, "tanh"),
+        new dense_layer(12, "relu"),
+        new dense_layer(8, "sigmoid"),
+        new dense_layer(OUTPUT_SIZE, "softmax")
+    }, "cce", 1);
+
+    // Batch normalization. forward() moves the running statistics, so this
+    // one is compared against the inference path, which uses them frozen.
+    NeuralNetwork batch_nn({
+        new normalization_layer(INPUT_SIZE, "batch"),
+        new activation_layer(INPUT_SIZE, "tanh"),
+        new dense_layer(12, "tanh"),
+        new gating_layer(12),
+        new dense_layer(OUTPUT_SIZE, "softmax")
+    }, "cce", 2);
+
+    for (size_t e = 0; e < 3; ++e)
+    {
+        layer_nn.backprop(dataset);
+        batch_nn.backprop(dataset);
+    }
+
+    vec2<float> layer_expected, batch_expected;
+    for (const auto& x : cases)
+    {
+        layer_expected.push_back(layer_nn.forward(x));
+        std::span<const float> out = batch_nn.infer(x);
+        batch_expected.emplace_back(out.begin(), out.end());
+    }
+
+    std::ofstream layer_header(dir + "/layer_model.hpp");
+    layer_nn.export_header(layer_header, INPUT_SIZE, "layer_model");
+    std::ofstream batch_header(dir + "/batch_model.hpp");
+    batch_nn.export_header(batch_header, INPUT_SIZE, "batch_model");
+
+    std::ofstream expected(dir + "/export_cases.hpp");
+    expected << "// Generated by export_models, do not edit\n#pragma once\n\n"
+             << "#include <cstddef>\n#include <limits>\n\nnamespace export_cases\n{\n\n"
+             << "inline constexpr size_t num_cases = " << cases.size() << ";\n\n";
+    write_array(expected, "inputs", cases);
+    write_array(expected, "layer_expected", layer_expected);
+    write_array(expected, "batch_expected", batch_expected);
+    expected << "} // namespace export_cases\n";
+
+    if (!layer_header || !batch_header || !expected)
+    {
+        std::cerr << "export_models: failed to write to " << dir << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Checks that headers written by NeuralNetwork::export_header compute what
+// the library does. Built against the output of export_models.
+
+#include <cmath>
+#include "check.hpp"
+#include "layer_model.hpp"
+#include "batch_model.hpp"
+#include "export_cases.hpp"
+
+// Largest allowed difference of any output (softmax probabilities). The
+// exported code repeats the library's operations in the same order, so
+// differences only come from the compiler contracting or vectorizing the
+// two differently.
+#define EXPORT_TOLERANCE 1e-6f
+
+template <size_t N>
+static float max_error(void (*infer)(const float*, float*), const float (&expected)[export_cases::num_cases][N])
+{
+    float worst = 0.0f;
+    for (size_t c = 0; c < export_cases::num_cases; ++c)
+    {
+        float out[N];
+        infer(export_cases::inputs[c], out);
+        for (size_t i = 0; i < N; ++i)
+            worst = std::max(worst, std::fabs(out[i] - expected[c][i]));
+    }
+
+    return worst;
+}
+
+int main()
+{
+    static_assert(layer_model::output_size == std::size(export_cases::layer_expected[0]));
+    static_assert(batch_model::output_size == std::size(export_cases::batch_expected[0]));
+
+    const float layer_error = max_error(layer_model::infer, export_cases::layer_expected);
+    const float batch_error = max_error(batch_model::infer, export_cases::batch_expected);
+    std::cout << "export: max error layer norm " << layer_error << ", batch norm " << batch_error
+              << " (tolerance " << EXPORT_TOLERANCE << ")" << std::endl;
+
+    CHECK(layer_error <= EXPORT_TOLERANCE);
+    CHECK(batch_error <= EXPORT_TOLERANCE);
+    return check_failures;
+}